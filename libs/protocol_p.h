@@ -82,6 +82,7 @@
 #define AKONADI_CMD_ITEMUNLINK       "UNLINK"
 #define AKONADI_CMD_UNSUBSCRIBE      "UNSUBSCRIBE"
 #define AKONADI_CMD_ITEMCREATE       "X-AKAPPEND"
+#define AKONADI_CMD_ITEMBATCHMERGE   "X-AKBATCHMERGE"
 #define AKONADI_CMD_X_AKLIST         "X-AKLIST"
 #define AKONADI_CMD_X_AKLSUB         "X-AKLSUB"
 
@@ -90,6 +91,7 @@
 #define AKONADI_PARAM_ALLATTRIBUTES                "ALLATTR"
 #define AKONADI_PARAM_ANCESTORS                    "ANCESTORS"
 #define AKONADI_PARAM_ATR                          "ATR:"
+#define AKONADI_PARAM_BACKGROUND                   "BACKGROUND"
 #define AKONADI_PARAM_CACHEONLY                    "CACHEONLY"
 #define AKONADI_PARAM_CACHEDPARTS                  "CACHEDPARTS"
 #define AKONADI_PARAM_CACHETIMEOUT                 "CACHETIMEOUT"
@@ -100,6 +102,7 @@
 #define AKONADI_PARAM_COLLECTION                   "COLLECTION"
 #define AKONADI_PARAM_COLLECTIONID                 "COLLECTIONID"
 #define AKONADI_PARAM_COLLECTIONS                  "COLLECTIONS"
+#define AKONADI_PARAM_CONTINUE                     "CONTINUE"
 #define AKONADI_PARAM_MTIME                        "DATETIME"
 #define AKONADI_PARAM_CAPABILITY_DIRECTSTREAMING   "DIRECTSTREAMING"
 #define AKONADI_PARAM_UNDIRTY                      "DIRTY"
@@ -118,6 +121,7 @@
 #define AKONADI_PARAM_INVALIDATECACHE              "INVALIDATECACHE"
 #define AKONADI_PARAM_MIMETYPE                     "MIMETYPE"
 #define AKONADI_PARAM_MERGE                        "MERGE"
+#define AKONADI_PARAM_LIMIT                        "LIMIT"
 #define AKONADI_PARAM_LOCALPARTS                   "LOCALPARTS"
 #define AKONADI_PARAM_NAME                         "NAME"
 #define AKONADI_PARAM_CAPABILITY_NOTIFY            "NOTIFY"
@@ -127,6 +131,7 @@
 #define AKONADI_PARAM_PARTS                        "PARTS"
 #define AKONADI_PARAM_PLD                          "PLD:"
 #define AKONADI_PARAM_PLD_RFC822                   "PLD:RFC822"
+#define AKONADI_PARAM_PREFETCH                     "PREFETCH"
 #define AKONADI_PARAM_PERSISTENTSEARCH_QUERYCOLLECTIONS "QUERYCOLLECTIONS"
 #define AKONADI_PARAM_PERSISTENTSEARCH_QUERYLANG   "QUERYLANGUAGE"
 #define AKONADI_PARAM_PERSISTENTSEARCH_QUERYSTRING "QUERYSTRING"
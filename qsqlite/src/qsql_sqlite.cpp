@@ -352,13 +352,12 @@ bool QSQLiteResult::exec()
     clearValues();
     setLastError(QSqlError());
 
-    int res = sqlite3_reset(d->stmt);
-    if (res != SQLITE_OK) {
-        setLastError(qMakeError(d->access, QCoreApplication::translate("QSQLiteResult",
-                     "Unable to reset statement"), QSqlError::StatementError, res));
-        d->finalize();
-        return false;
-    }
+    // For statements prepared with sqlite3_prepare_v2() the return value of
+    // sqlite3_reset() is the error of the previous execution, which has been
+    // reported already. The statement itself is still valid, so keep it to
+    // allow executing cached prepared queries again after a failure.
+    sqlite3_reset(d->stmt);
+    int res = SQLITE_OK;
     int paramCount = sqlite3_bind_parameter_count(d->stmt);
     if (paramCount == values.count()) {
         for (int i = 0; i < paramCount; ++i) {
@@ -401,7 +400,7 @@ bool QSQLiteResult::exec()
             if (res != SQLITE_OK) {
                 setLastError(qMakeError(d->access, QCoreApplication::translate("QSQLiteResult",
                              "Unable to bind parameters"), QSqlError::StatementError, res));
-                d->finalize();
+                sqlite3_reset(d->stmt);
                 return false;
             }
         }
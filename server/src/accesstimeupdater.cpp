@@ -0,0 +1,133 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include "accesstimeupdater.h"
+#include "akdebug.h"
+#include "entities.h"
+#include "storage/datastore.h"
+#include "storage/querybuilder.h"
+#include "storage/transaction.h"
+
+#include <akstandarddirs.h>
+
+#include <QtCore/QDateTime>
+#include <QtCore/QSettings>
+#include <QtCore/QTimer>
+
+using namespace Akonadi::Server;
+
+// Interval in seconds in which buffered access times are written
+#define ACCESS_TIME_FLUSH_INTERVAL 30
+
+// Maximum number of item ids updated by a single query, the database may
+// allow less (see QueryBuilder::maxBindValues())
+#define ACCESS_TIME_BATCH_SIZE 1000
+
+AccessTimeUpdater::AccessTimeUpdater( QObject *parent )
+  : QThread( parent )
+{
+  const QSettings settings( AkStandardDirs::serverConfigFile(), QSettings::IniFormat );
+  mFlushInterval = qMax( 1, settings.value( QLatin1String( "Cache/AccessTimeFlushInterval" ), ACCESS_TIME_FLUSH_INTERVAL ).toInt() );
+}
+
+AccessTimeUpdater::~AccessTimeUpdater()
+{
+}
+
+void AccessTimeUpdater::itemsAccessed( const QVector<qint64> &ids )
+{
+  QMutexLocker locker( &mLock );
+  Q_FOREACH ( qint64 id, ids ) {
+    mPendingItems.insert( id );
+  }
+}
+
+int AccessTimeUpdater::pendingCount() const
+{
+  QMutexLocker locker( &mLock );
+  return mPendingItems.size();
+}
+
+bool AccessTimeUpdater::flush()
+{
+  QSet<qint64> items;
+  {
+    QMutexLocker locker( &mLock );
+    items.swap( mPendingItems );
+  }
+  if ( items.isEmpty() ) {
+    return true;
+  }
+
+  // The items have been accessed at most one flush interval ago, which is
+  // well below the granularity of cache timeouts (minutes)
+  const QDateTime now = QDateTime::currentDateTime();
+
+  // the atime takes one of the bind values
+  const int batchSize = qMin( ACCESS_TIME_BATCH_SIZE,
+                              QueryBuilder::maxBindValues( DbType::type( DataStore::self()->database() ) ) - 1 );
+
+  Transaction transaction( DataStore::self() );
+  QVariantList batch;
+  batch.reserve( batchSize );
+  QSet<qint64>::ConstIterator it = items.constBegin();
+  while ( it != items.constEnd() ) {
+    batch << *it;
+    ++it;
+    if ( batch.size() < batchSize && it != items.constEnd() ) {
+      continue;
+    }
+
+    QueryBuilder qb( PimItem::tableName(), QueryBuilder::Update );
+    qb.setColumnValue( PimItem::atimeColumn(), now );
+    qb.addValueCondition( PimItem::idColumn(), Query::In, batch );
+    if ( !qb.exec() ) {
+      akError() << "Unable to update item access time";
+      // try again with the next flush
+      QMutexLocker locker( &mLock );
+      mPendingItems.unite( items );
+      return false;
+    }
+    batch.clear();
+  }
+
+  if ( !transaction.commit() ) {
+    QMutexLocker locker( &mLock );
+    mPendingItems.unite( items );
+    return false;
+  }
+  return true;
+}
+
+void AccessTimeUpdater::run()
+{
+  DataStore::self();
+
+  QTimer timer;
+  timer.setInterval( mFlushInterval * 1000 );
+  // the timer lives in this thread, flush() has to run here as well
+  connect( &timer, SIGNAL(timeout()), this, SLOT(flush()), Qt::DirectConnection );
+  timer.start();
+
+  exec();
+
+  timer.stop();
+  flush();
+  DataStore::self()->close();
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef AKONADI_ACCESSTIMEUPDATER_H
+#define AKONADI_ACCESSTIMEUPDATER_H
+
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+namespace Akonadi {
+namespace Server {
+
+/**
+ * Write-behind buffer for item access times.
+ *
+ * Connections only record which items have been accessed, the buffered ids
+ * are written in batches from this thread every few seconds. This keeps
+ * write transactions out of the FETCH path.
+ *
+ * Everything reading the access times (i.e. the CacheCleaner) has to call
+ * flush() first to see the items accessed since the last periodic flush.
+ */
+class AccessTimeUpdater : public QThread
+{
+  Q_OBJECT
+
+  public:
+    explicit AccessTimeUpdater( QObject *parent = 0 );
+    ~AccessTimeUpdater();
+
+    /**
+     * Records that the items @p ids have been accessed just now.
+     * This method is thread-safe.
+     */
+    void itemsAccessed( const QVector<qint64> &ids );
+
+    /**
+     * Returns the number of items whose access time has not been written yet.
+     */
+    int pendingCount() const;
+
+  public Q_SLOTS:
+    /**
+     * Writes the access time of all recorded items to the database, using
+     * the DataStore of the calling thread. This method is thread-safe.
+     */
+    bool flush();
+
+  protected:
+    virtual void run();
+
+  private:
+    mutable QMutex mLock;
+    QSet<qint64> mPendingItems;
+    int mFlushInterval;
+};
+
+} // namespace Server
+} // namespace Akonadi
+
+#endif
@@ -0,0 +1,246 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include "agentmetadatacache.h"
+#include "agentmanagerinterface.h"
+#include "akdbus.h"
+#include "akdebug.h"
+
+#include <QtCore/QThreadStorage>
+#include <QtCore/QTimer>
+
+using namespace Akonadi::Server;
+
+// Interval in milliseconds in which populating the cache, or retrieving the
+// metadata of single instances, is retried while the AgentManager is not reachable
+#define POPULATE_RETRY_INTERVAL 5000
+
+namespace {
+
+struct LocalAgentMetadata
+{
+  LocalAgentMetadata()
+    : generation( 0 )
+  {
+  }
+
+  int generation;
+  QHash<QString, AgentMetadataCache::AgentInfo> agents;
+};
+
+}
+
+// the copy of the metadata used by the current thread
+static QThreadStorage<LocalAgentMetadata> sLocalMetadata;
+
+AgentMetadataCache::AgentInfo::AgentInfo()
+  : hasLocalStorage( false )
+  , maxConcurrentRetrievals( 0 )
+  , online( false )
+  , status( 0 )
+{
+}
+
+AgentMetadataCache::AgentMetadataCache( QObject *parent )
+  : QObject( parent )
+  , mRetryScheduled( false )
+  , mGeneration( 0 )
+{
+  mManager = new OrgFreedesktopAkonadiAgentManagerInterface( AkDBus::serviceName( AkDBus::Control ),
+                                                             QLatin1String( "/AgentManager" ),
+                                                             QDBusConnection::sessionBus(), this );
+  connect( mManager, SIGNAL(agentInstanceAdded(QString)),
+           this, SLOT(agentInstanceAdded(QString)) );
+  connect( mManager, SIGNAL(agentInstanceRemoved(QString)),
+           this, SLOT(agentInstanceRemoved(QString)) );
+  connect( mManager, SIGNAL(agentInstanceStatusChanged(QString,int,QString)),
+           this, SLOT(agentInstanceStatusChanged(QString,int,QString)) );
+  connect( mManager, SIGNAL(agentInstanceOnlineChanged(QString,bool)),
+           this, SLOT(agentInstanceOnlineChanged(QString,bool)) );
+
+  // don't block the server startup on the control process
+  QTimer::singleShot( 0, this, SLOT(populate()) );
+}
+
+AgentMetadataCache::~AgentMetadataCache()
+{
+}
+
+bool AgentMetadataCache::agentInfo( const QString &identifier, AgentInfo &info ) const
+{
+  const int generation = const_cast<QAtomicInt &>( mGeneration ).fetchAndAddAcquire( 0 );
+  if ( generation == 0 ) {
+    return false;
+  }
+
+  LocalAgentMetadata &local = sLocalMetadata.localData();
+  if ( local.generation != generation ) {
+    QMutexLocker locker( &mLock );
+    local.agents = mAgents;
+    local.generation = generation;
+  }
+
+  QHash<QString, AgentInfo>::ConstIterator it = local.agents.constFind( identifier );
+  if ( it == local.agents.constEnd() ) {
+    return false;
+  }
+  info = it.value();
+  return true;
+}
+
+bool AgentMetadataCache::retrieveAgentInfo( const QString &identifier, AgentInfo &info )
+{
+  const QDBusReply<QString> type = mManager->agentInstanceType( identifier );
+  const QDBusReply<bool> online = mManager->agentInstanceOnline( identifier );
+  const QDBusReply<int> status = mManager->agentInstanceStatus( identifier );
+  if ( !type.isValid() || !online.isValid() || !status.isValid() ) {
+    akError() << "Failed to retrieve metadata of agent instance" << identifier;
+    return false;
+  }
+  info.type = type.value();
+  info.online = online.value();
+  info.status = status.value();
+
+  QHash<QString, QVariantMap>::ConstIterator it = mTypeProperties.constFind( info.type );
+  if ( it == mTypeProperties.constEnd() ) {
+    const QDBusReply<QVariantMap> properties = mManager->agentCustomProperties( info.type );
+    if ( !properties.isValid() ) {
+      akError() << "Failed to retrieve properties of agent type" << info.type << ":" << properties.error().message();
+      return false;
+    }
+    it = mTypeProperties.insert( info.type, properties.value() );
+  }
+  info.hasLocalStorage = it.value().value( QLatin1String( "HasLocalStorage" ), false ).toBool();
+  info.maxConcurrentRetrievals = qMax( 0, it.value().value( QLatin1String( "MaxConcurrentRetrievals" ), 0 ).toInt() );
+  return true;
+}
+
+void AgentMetadataCache::updateAgent( const QString &identifier, const AgentInfo &info )
+{
+  QMutexLocker locker( &mLock );
+  mAgents.insert( identifier, info );
+  if ( mGeneration.fetchAndAddOrdered( 0 ) != 0 ) {
+    mGeneration.fetchAndAddOrdered( 1 );
+  }
+}
+
+void AgentMetadataCache::populate()
+{
+  const QDBusReply<QStringList> reply = mManager->agentInstances();
+  if ( !reply.isValid() ) {
+    akError() << "Failed to retrieve agent instances:" << reply.error().message();
+    // the cache stays disabled until this succeeds
+    QTimer::singleShot( POPULATE_RETRY_INTERVAL, this, SLOT(populate()) );
+    return;
+  }
+
+  QHash<QString, AgentInfo> agents;
+  Q_FOREACH ( const QString &identifier, reply.value() ) {
+    AgentInfo info;
+    if ( retrieveAgentInfo( identifier, info ) ) {
+      agents.insert( identifier, info );
+    } else {
+      addPendingAgent( identifier );
+    }
+  }
+
+  QMutexLocker locker( &mLock );
+  // keep what the change signals delivered in the meantime
+  QHash<QString, AgentInfo>::ConstIterator it = mAgents.constBegin();
+  for ( ; it != mAgents.constEnd(); ++it ) {
+    agents.insert( it.key(), it.value() );
+  }
+  mAgents = agents;
+  mGeneration.fetchAndAddOrdered( 1 );
+  akDebug() << "Cached metadata of" << mAgents.count() << "agent instances";
+}
+
+void AgentMetadataCache::addPendingAgent( const QString &identifier )
+{
+  mPendingAgents.insert( identifier );
+  if ( !mRetryScheduled ) {
+    mRetryScheduled = true;
+    QTimer::singleShot( POPULATE_RETRY_INTERVAL, this, SLOT(retryPendingAgents()) );
+  }
+}
+
+void AgentMetadataCache::retryPendingAgents()
+{
+  mRetryScheduled = false;
+  const QSet<QString> pending = mPendingAgents;
+  mPendingAgents.clear();
+  Q_FOREACH ( const QString &identifier, pending ) {
+    AgentInfo info;
+    if ( retrieveAgentInfo( identifier, info ) ) {
+      updateAgent( identifier, info );
+    } else {
+      addPendingAgent( identifier );
+    }
+  }
+}
+
+void AgentMetadataCache::agentInstanceAdded( const QString &identifier )
+{
+  AgentInfo info;
+  if ( retrieveAgentInfo( identifier, info ) ) {
+    updateAgent( identifier, info );
+  } else {
+    addPendingAgent( identifier );
+  }
+}
+
+void AgentMetadataCache::agentInstanceRemoved( const QString &identifier )
+{
+  mPendingAgents.remove( identifier );
+
+  QMutexLocker locker( &mLock );
+  if ( mAgents.remove( identifier ) > 0 && mGeneration.fetchAndAddOrdered( 0 ) != 0 ) {
+    mGeneration.fetchAndAddOrdered( 1 );
+  }
+}
+
+void AgentMetadataCache::agentInstanceStatusChanged( const QString &identifier, int status, const QString &message )
+{
+  Q_UNUSED( message );
+
+  AgentInfo info;
+  {
+    QMutexLocker locker( &mLock );
+    if ( !mAgents.contains( identifier ) ) {
+      return;
+    }
+    info = mAgents.value( identifier );
+  }
+  info.status = status;
+  updateAgent( identifier, info );
+}
+
+void AgentMetadataCache::agentInstanceOnlineChanged( const QString &identifier, bool online )
+{
+  AgentInfo info;
+  {
+    QMutexLocker locker( &mLock );
+    if ( !mAgents.contains( identifier ) ) {
+      return;
+    }
+    info = mAgents.value( identifier );
+  }
+  info.online = online;
+  updateAgent( identifier, info );
+}
@@ -0,0 +1,109 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef AKONADI_AGENTMETADATACACHE_H
+#define AKONADI_AGENTMETADATACACHE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QVariant>
+
+class OrgFreedesktopAkonadiAgentManagerInterface;
+
+namespace Akonadi {
+namespace Server {
+
+/**
+ * Server-side cache of the agent instance metadata maintained by the
+ * AgentManager of the control process.
+ *
+ * The cache is populated once after the server has started, retrying until
+ * the AgentManager can be reached, and then kept up-to-date from the
+ * AgentManager change signals. Instances whose metadata could not be retrieved
+ * are left out and retried in the same interval, so that connection and search threads don't
+ * have to do blocking D-Bus calls to the control process.
+ *
+ * Every reading thread keeps its own copy of the metadata, which is only
+ * refreshed (under a lock) after the cache has changed. Reading the
+ * metadata is therefore lock-free as long as nothing changes.
+ *
+ * The cache lives in the main thread.
+ */
+class AgentMetadataCache : public QObject
+{
+  Q_OBJECT
+
+  public:
+    struct AgentInfo
+    {
+      AgentInfo();
+
+      QString type;
+      bool hasLocalStorage;
+      /// number of items the agent can retrieve concurrently, 0 if not specified
+      int maxConcurrentRetrievals;
+      bool online;
+      int status;
+    };
+
+    explicit AgentMetadataCache( QObject *parent = 0 );
+    ~AgentMetadataCache();
+
+    /**
+     * Looks up the metadata of agent instance @p identifier.
+     * Returns false if the instance is unknown or the cache is not populated yet,
+     * callers should ask the AgentManager directly in that case.
+     * This method is thread-safe.
+     */
+    bool agentInfo( const QString &identifier, AgentInfo &info ) const;
+
+  private Q_SLOTS:
+    void populate();
+    void retryPendingAgents();
+    void agentInstanceAdded( const QString &identifier );
+    void agentInstanceRemoved( const QString &identifier );
+    void agentInstanceStatusChanged( const QString &identifier, int status, const QString &message );
+    void agentInstanceOnlineChanged( const QString &identifier, bool online );
+
+  private:
+    bool retrieveAgentInfo( const QString &identifier, AgentInfo &info );
+    void updateAgent( const QString &identifier, const AgentInfo &info );
+    void addPendingAgent( const QString &identifier );
+
+    OrgFreedesktopAkonadiAgentManagerInterface *mManager;
+    // agent type -> custom properties, types don't change during runtime
+    QHash<QString, QVariantMap> mTypeProperties;
+    // instances whose metadata could not be retrieved yet
+    QSet<QString> mPendingAgents;
+    bool mRetryScheduled;
+
+    mutable QMutex mLock;
+    QHash<QString, AgentInfo> mAgents;
+    // incremented on every change, 0 while not populated yet
+    QAtomicInt mGeneration;
+};
+
+} // namespace Server
+} // namespace Akonadi
+
+#endif
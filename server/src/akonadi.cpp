@@ -24,6 +24,8 @@
 #include <akdebug.h>
 #include <akstandarddirs.h>
 
+#include "accesstimeupdater.h"
+#include "agentmetadatacache.h"
 #include "cachecleaner.h"
 #include "intervalcheck.h"
 #include "storagejanitor.h"
@@ -73,6 +75,8 @@ AkonadiServer* AkonadiServer::s_instance = 0;
 AkonadiServer::AkonadiServer( QObject *parent )
     : QLocalServer( parent )
     , mCacheCleaner( 0 )
+    , mAccessTimeUpdater( 0 )
+    , mAgentMetadataCache( 0 )
     , mIntervalChecker( 0 )
     , mStorageJanitor( 0 )
     , mItemRetrievalThread( 0 )
@@ -185,6 +189,11 @@ bool AkonadiServer::init()
         mCacheCleaner->start( QThread::IdlePriority );
     }
 
+    mAgentMetadataCache = new AgentMetadataCache( this );
+
+    mAccessTimeUpdater = new AccessTimeUpdater( this );
+    mAccessTimeUpdater->start( QThread::LowPriority );
+
     mIntervalChecker = new IntervalCheck( this );
     mIntervalChecker->start( QThread::IdlePriority );
 
@@ -277,6 +286,9 @@ bool AkonadiServer::quit()
     }
     mConnections.clear();
 
+    // Write the remaining access times once no connection can record new ones
+    quitThread( mAccessTimeUpdater );
+
     // Terminate the preprocessor manager before the database but after all connections are gone
     PreprocessorManager::done();
 
@@ -398,6 +410,16 @@ CacheCleaner* AkonadiServer::cacheCleaner()
     return mCacheCleaner;
 }
 
+AccessTimeUpdater* AkonadiServer::accessTimeUpdater()
+{
+    return mAccessTimeUpdater;
+}
+
+AgentMetadataCache* AkonadiServer::agentMetadataCache()
+{
+    return mAgentMetadataCache;
+}
+
 IntervalCheck* AkonadiServer::intervalChecker()
 {
     return mIntervalChecker;
@@ -32,6 +32,8 @@ namespace Server {
 
 class ConnectionThread;
 class CacheCleaner;
+class AccessTimeUpdater;
+class AgentMetadataCache;
 class SearchManagerThread;
 class ItemRetrievalThread;
 class SearchTaskManagerThread;
@@ -51,6 +53,16 @@ class AkonadiServer : public QLocalServer
      */
     CacheCleaner *cacheCleaner();
 
+    /**
+     * Can return a nullptr
+     */
+    AccessTimeUpdater *accessTimeUpdater();
+
+    /**
+     * Can return a nullptr
+     */
+    AgentMetadataCache *agentMetadataCache();
+
     /**
      * Can return a nullptr
      */
@@ -82,6 +94,8 @@ class AkonadiServer : public QLocalServer
     AkonadiServer( QObject *parent = 0 );
 
     CacheCleaner *mCacheCleaner;
+    AccessTimeUpdater *mAccessTimeUpdater;
+    AgentMetadataCache *mAgentMetadataCache;
     IntervalCheck *mIntervalChecker;
     StorageJanitorThread *mStorageJanitor;
     ItemRetrievalThread *mItemRetrievalThread;
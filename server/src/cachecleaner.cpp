@@ -19,6 +19,7 @@
 */
 
 #include "cachecleaner.h"
+#include "accesstimeupdater.h"
 #include "akdebug.h"
 #include "storage/parthelper.h"
 #include "storage/datastore.h"
@@ -116,6 +117,11 @@ bool CacheCleaner::shouldScheduleCollection( const Collection &collection )
 
 void CacheCleaner::collectionExpired( const Collection &collection )
 {
+  // Make sure items read since the last periodic flush are not considered expired
+  if ( AccessTimeUpdater *updater = AkonadiServer::instance()->accessTimeUpdater() ) {
+    updater->flush();
+  }
+
   SelectQueryBuilder<Part> qb;
   qb.addJoin( QueryBuilder::InnerJoin, PimItem::tableName(), Part::pimItemIdColumn(), PimItem::idFullColumnName() );
   qb.addJoin( QueryBuilder::InnerJoin, PartType::tableName(), Part::partTypeIdFullColumnName(), PartType::idFullColumnName() );
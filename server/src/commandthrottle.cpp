@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2014  Akonadi developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "commandthrottle.h"
+
+#include <QtCore/QSemaphore>
+#include <QtCore/QSettings>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+
+#include "storage/datastore.h"
+#include "shared/akdebug.h"
+
+#include <akstandarddirs.h>
+
+using namespace Akonadi::Server;
+
+static int readMaximumConcurrentCommands()
+{
+    const QSettings settings( AkStandardDirs::serverConfigFile(), QSettings::IniFormat );
+    int max = settings.value( QLatin1String( "Connection/MaxConcurrentCommands" ), 0 ).toInt();
+    if ( max < 0 ) {
+        max = qMax( QThread::idealThreadCount(), 1 );
+    }
+    if ( max > 0 ) {
+        akDebug() << "Limiting concurrently executed commands to" << max;
+    }
+    return max;
+}
+
+static QSemaphore *commandSlots()
+{
+    static QSemaphore *sSlots = CommandThrottle::maximumConcurrentCommands() > 0
+                                ? new QSemaphore( CommandThrottle::maximumConcurrentCommands() ) : 0;
+    return sSlots;
+}
+
+// whether the current thread occupies a slot
+static QThreadStorage<bool> sHoldsSlot;
+
+int CommandThrottle::maximumConcurrentCommands()
+{
+    static const int sMax = readMaximumConcurrentCommands();
+    return sMax;
+}
+
+int CommandThrottle::availableSlots()
+{
+    QSemaphore *semaphore = commandSlots();
+    return semaphore ? semaphore->available() : 0;
+}
+
+bool CommandThrottle::acquire()
+{
+    QSemaphore *semaphore = commandSlots();
+    if ( !semaphore || sHoldsSlot.localData() ) {
+        return false;
+    }
+    // A connection inside a transaction may hold locks the commands occupying
+    // all slots are waiting for, it must be able to proceed to its COMMIT
+    if ( DataStore::hasDataStore() && DataStore::self()->inTransaction() ) {
+        return false;
+    }
+    semaphore->acquire();
+    sHoldsSlot.setLocalData( true );
+    return true;
+}
+
+void CommandThrottle::release()
+{
+    commandSlots()->release();
+    sHoldsSlot.setLocalData( false );
+}
+
+CommandThrottle::Slot::Slot()
+    : mAcquired( CommandThrottle::acquire() )
+{
+}
+
+CommandThrottle::Slot::~Slot()
+{
+    // A Suspender may have been unable to take the slot back within a transaction
+    if ( mAcquired && sHoldsSlot.localData() ) {
+        CommandThrottle::release();
+    }
+}
+
+CommandThrottle::Suspender::Suspender()
+    : mSuspended( false )
+{
+    if ( commandSlots() && sHoldsSlot.localData() ) {
+        CommandThrottle::release();
+        mSuspended = true;
+    }
+}
+
+CommandThrottle::Suspender::~Suspender()
+{
+    if ( mSuspended ) {
+        CommandThrottle::acquire();
+    }
+}
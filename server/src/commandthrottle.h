@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2014  Akonadi developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef AKONADI_SERVER_COMMANDTHROTTLE_H
+#define AKONADI_SERVER_COMMANDTHROTTLE_H
+
+#include <QtGlobal>
+
+namespace Akonadi
+{
+namespace Server
+{
+
+/**
+ * Limits the number of commands that are executed concurrently by all
+ * connection threads, and thereby the number of database connections
+ * that are busy at the same time.
+ *
+ * The limit is configured by the Connection/MaxConcurrentCommands setting,
+ * 0 (the default) disables the limit. A negative value limits the concurrency
+ * to the number of CPU cores.
+ */
+class CommandThrottle
+{
+public:
+    /**
+     * Occupies an execution slot for its lifetime, blocking until one is available.
+     * Connections with an open transaction are not throttled.
+     */
+    class Slot
+    {
+    public:
+        Slot();
+        ~Slot();
+
+    private:
+        Q_DISABLE_COPY( Slot )
+        bool mAcquired;
+    };
+
+    /**
+     * Gives back the slot held by the current thread for its lifetime.
+     *
+     * Use this around operations that block on other connections, like
+     * waiting for a resource to deliver an item, which would otherwise
+     * deadlock when all slots are taken.
+     */
+    class Suspender
+    {
+    public:
+        Suspender();
+        ~Suspender();
+
+    private:
+        Q_DISABLE_COPY( Suspender )
+        bool mSuspended;
+    };
+
+    /**
+     * Returns the maximum number of concurrently executed commands,
+     * or 0 when unlimited.
+     */
+    static int maximumConcurrentCommands();
+
+    /**
+     * Returns the number of execution slots currently not occupied,
+     * or 0 when unlimited.
+     */
+    static int availableSlots();
+
+private:
+    static bool acquire();
+    static void release();
+};
+
+}
+}
+
+#endif // AKONADI_SERVER_COMMANDTHROTTLE_H
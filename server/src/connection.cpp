@@ -21,15 +21,21 @@
 
 #include <QtCore/QDebug>
 #include <QtCore/QEventLoop>
+#include <QtCore/QFile>
 #include <QtCore/QLatin1String>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QTime>
+#include <QtCore/QTimer>
 #include <QSettings>
 
 #include "storage/datastore.h"
+#include "storage/querycache.h"
 #include "handler.h"
 #include "response.h"
 #include "tracer.h"
 #include "clientcapabilityaggregator.h"
 #include "collectionreferencemanager.h"
+#include "commandthrottle.h"
 
 #include "imapstreamparser.h"
 #include "shared/akdebug.h"
@@ -39,10 +45,37 @@
 
 #include <assert.h>
 
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <poll.h>
+#include <sys/sendfile.h>
+#endif
+
 #define AKONADI_PROTOCOL_VERSION 44
 
+// Default amount of queued response data after which response producers are
+// blocked until the client has read the data
+#define OUTPUT_HIGH_WATER_MARK ( 4 * 1024 * 1024 ) // 4 MB
+
+// Untagged responses are collected and written to the socket in a single
+// call once the batch exceeds this size or age
+#define OUTPUT_BATCH_SIZE ( 64 * 1024 ) // 64 kB
+#define OUTPUT_BATCH_INTERVAL 50 // ms
+
+// Idle time after which the database connection of a client is closed, it is
+// reopened transparently with the next command. Disabled by default, as closing
+// the connection also drops the cached prepared queries
+#define DATABASE_IDLE_TIMEOUT 0 // seconds
+
+// Maximum amount of payload file data passed to a single sendfile() call
+#define SENDFILE_CHUNK_SIZE ( 1024 * 1024 ) // 1 MB
+
 using namespace Akonadi::Server;
 
+// client connections, for the output statistics
+static QMutex sConnectionsLock;
+static QList<Connection *> sConnections;
+
 Connection::Connection( QObject *parent )
     : QObject( parent )
     , m_socketDescriptor( 0 )
@@ -52,6 +85,15 @@ Connection::Connection( QObject *parent )
     , m_backend( 0 )
     , m_streamParser( 0 )
     , m_verifyCacheOnRetrieval( false )
+    , m_outputFlushTimer( 0 )
+    , m_outputBatchSize( OUTPUT_BATCH_SIZE )
+    , m_outputBatchInterval( OUTPUT_BATCH_INTERVAL )
+    , m_outputHighWaterMark( OUTPUT_HIGH_WATER_MARK )
+    , m_outputLowWaterMark( OUTPUT_HIGH_WATER_MARK / 2 )
+    , m_outputBytesQueued( 0 )
+    , m_outputStallTime( 0 )
+    , m_outputStallCount( 0 )
+    , m_dbIdleTimer( 0 )
 {
 }
 
@@ -65,6 +107,16 @@ Connection::Connection( quintptr socketDescriptor, QObject *parent )
 
     const QSettings settings( AkStandardDirs::serverConfigFile(), QSettings::IniFormat );
     m_verifyCacheOnRetrieval = settings.value( QLatin1String( "Cache/VerifyOnRetrieval" ), m_verifyCacheOnRetrieval ).toBool();
+    m_outputHighWaterMark = qMax( settings.value( QLatin1String( "Connection/OutputHighWaterMark" ), m_outputHighWaterMark ).toLongLong(), Q_INT64_C( 1024 ) );
+    m_outputLowWaterMark = m_outputHighWaterMark / 2;
+    m_outputBatchSize = settings.value( QLatin1String( "Connection/OutputBatchSize" ), m_outputBatchSize ).toInt();
+    m_outputBatchInterval = settings.value( QLatin1String( "Connection/OutputBatchInterval" ), m_outputBatchInterval ).toInt();
+    m_outputBuffer.reserve( m_outputBatchSize );
+
+    {
+        QMutexLocker locker( &sConnectionsLock );
+        sConnections.append( this );
+    }
 
     QLocalSocket *socket = new QLocalSocket();
 
@@ -92,6 +144,23 @@ Connection::Connection( quintptr socketDescriptor, QObject *parent )
     connect( socket, SIGNAL(disconnected()),
              this, SIGNAL(disconnected()) );
 
+    // Flush batched responses as soon as we get back to the event loop
+    m_outputFlushTimer = new QTimer( this );
+    m_outputFlushTimer->setSingleShot( true );
+    m_outputFlushTimer->setInterval( 0 );
+    connect( m_outputFlushTimer, SIGNAL(timeout()),
+             this, SLOT(flushOutput()) );
+
+    const int dbIdleTimeout = settings.value( QLatin1String( "Connection/DatabaseIdleTimeout" ), DATABASE_IDLE_TIMEOUT ).toInt();
+    if ( dbIdleTimeout > 0 ) {
+        m_dbIdleTimer = new QTimer( this );
+        m_dbIdleTimer->setSingleShot( true );
+        m_dbIdleTimer->setInterval( dbIdleTimeout * 1000 );
+        connect( m_dbIdleTimer, SIGNAL(timeout()),
+                 this, SLOT(releaseIdleDatabase()) );
+        m_dbIdleTimer->start();
+    }
+
     m_streamParser = new ImapStreamParser( m_socket );
     m_streamParser->setTracerIdentifier( m_identifier );
 
@@ -112,9 +181,8 @@ int Connection::protocolVersion()
 
 DataStore *Connection::storageBackend()
 {
-    if ( !m_backend ) {
-      m_backend = DataStore::self();
-    }
+    // always go through self(), it reopens the database connection if it was released while idle
+    m_backend = DataStore::self();
     return m_backend;
 }
 
@@ -125,6 +193,16 @@ CollectionReferenceManager *Connection::collectionReferenceManager()
 
 Connection::~Connection()
 {
+    {
+        QMutexLocker locker( &sConnectionsLock );
+        sConnections.removeOne( this );
+    }
+
+    if ( m_outputStallCount > 0 ) {
+        akDebug() << "Connection" << m_identifier << "queued" << m_outputBytesQueued << "bytes, output was stalled"
+                  << m_outputStallCount << "times for" << m_outputStallTime << "ms in total";
+    }
+
     delete m_socket;
     m_socket = 0;
     delete m_streamParser;
@@ -142,7 +220,14 @@ void Connection::slotNewData()
     return;
   }
 
-  while ( m_socket->bytesAvailable() > 0 || !m_streamParser->readRemainingData().isEmpty() ) {
+  // handlers may process events while waiting for item retrieval, don't let
+  // the database connection be released in the middle of a command
+  if ( m_dbIdleTimer ) {
+    m_dbIdleTimer->stop();
+  }
+
+  while ( m_socket->bytesAvailable() > 0 || m_streamParser->hasRemainingData() ) {
+    QScopedPointer<CommandThrottle::Slot> slot;
     try {
       const QByteArray tag = m_streamParser->readString();
       // deal with stray newlines
@@ -153,6 +238,9 @@ void Connection::slotNewData()
       if ( command.isEmpty() ) {
         throw Akonadi::Server::Exception("empty command");
       }
+      // limits the number of commands hitting the database at the same time,
+      // only taken now so that waiting for a slow client does not occupy a slot
+      slot.reset( new CommandThrottle::Slot );
       // Tag context is not persistent, unlike Collection
       // FIXME: Collection should not be persistent either, but we need to keep backward compatibility
       //        with SELECT job
@@ -194,22 +282,168 @@ void Connection::slotNewData()
     }
     delete m_currentHandler;
     m_currentHandler = 0;
+    // cached queries the handler did not read until the end would keep their tables locked
+    QueryCache::finishQueries();
 
     if ( m_streamParser->readRemainingData().startsWith( '\n' ) || m_streamParser->readRemainingData().startsWith( "\r\n" ) ) {
       try {
         m_streamParser->readUntilCommandEnd(); //just eat the ending newline
       } catch ( ... ) {}
     }
+
+    flushOutput();
+  }
+
+  if ( m_dbIdleTimer ) {
+    m_dbIdleTimer->start();
   }
 }
 
-void Connection::writeOut( const QByteArray &data )
+void Connection::flushOutput()
 {
-    QByteArray block = data + "\r\n";
-    m_socket->write( block );
-    m_socket->waitForBytesWritten( 30 * 1000 );
+    if ( m_outputFlushTimer ) {
+        m_outputFlushTimer->stop();
+    }
+    if ( m_outputBuffer.isEmpty() || !m_socket ) {
+        return;
+    }
 
-    Tracer::self()->connectionOutput( m_identifier, block );
+    writeOutput( m_outputBuffer );
+
+    m_outputBuffer.clear();
+    m_outputBuffer.reserve( m_outputBatchSize );
+}
+
+void Connection::writeOutput( const QByteArray &data )
+{
+    m_socket->write( data );
+    {
+        QMutexLocker locker( &m_outputStatisticsLock );
+        m_outputBytesQueued += data.size();
+    }
+
+    Tracer::self()->connectionOutput( m_identifier, data );
+
+    // The socket sends the queued data asynchronously from the event loop, we only
+    // push back on the response producer when the client does not keep up with reading
+    if ( m_socket->bytesToWrite() > m_outputHighWaterMark ) {
+        waitForOutputQueueDrained();
+    }
+}
+
+void Connection::writeStreamedResponse( const Response &response )
+{
+    QVector<Response::FileLiteral> fileLiterals;
+    response.appendTo( m_outputBuffer, fileLiterals );
+    const QByteArray buffer = m_outputBuffer;
+    m_outputBuffer.clear();
+    if ( m_outputFlushTimer ) {
+        m_outputFlushTimer->stop();
+    }
+
+    int pos = 0;
+    Q_FOREACH ( const Response::FileLiteral &literal, fileLiterals ) {
+        writeOutput( QByteArray::fromRawData( buffer.constData() + pos, literal.position - pos ) );
+        streamFileLiteral( literal );
+        pos = literal.position;
+    }
+    writeOutput( QByteArray::fromRawData( buffer.constData() + pos, buffer.size() - pos ) );
+
+    m_outputBuffer.reserve( m_outputBatchSize );
+}
+
+void Connection::streamFileLiteral( const Response::FileLiteral &literal )
+{
+    qint64 remaining = literal.size;
+    QFile file( literal.fileName );
+    if ( file.open( QIODevice::ReadOnly ) ) {
+#ifdef Q_OS_LINUX
+        // Let the kernel copy the file to the socket. sendfile() bypasses the
+        // socket's write buffer, so everything queued before has to go out first
+        QLocalSocket *socket = qobject_cast<QLocalSocket *>( m_socket );
+        if ( socket && socket->socketDescriptor() != -1 ) {
+            while ( socket->bytesToWrite() > 0 && socket->waitForBytesWritten( 30 * 1000 ) ) {
+            }
+            if ( socket->bytesToWrite() == 0 ) {
+                const int fd = socket->socketDescriptor();
+                off_t offset = 0;
+                while ( remaining > 0 ) {
+                    const ssize_t sent = ::sendfile( fd, file.handle(), &offset, qMin<qint64>( remaining, SENDFILE_CHUNK_SIZE ) );
+                    if ( sent > 0 ) {
+                        remaining -= sent;
+                        m_outputBytesQueued += sent;
+                        continue;
+                    }
+                    if ( sent < 0 && ( errno == EAGAIN || errno == EINTR ) ) {
+                        // the client does not read fast enough, wait for it
+                        const CommandThrottle::Suspender suspender;
+                        pollfd pfd;
+                        pfd.fd = fd;
+                        pfd.events = POLLOUT;
+                        pfd.revents = 0;
+                        if ( ::poll( &pfd, 1, 30 * 1000 ) > 0 ) {
+                            continue;
+                        }
+                    }
+                    // error or the file got shorter, handled below
+                    break;
+                }
+                Tracer::self()->connectionOutput( m_identifier, "[" + QByteArray::number( literal.size - remaining )
+                                                  + " bytes sent from " + literal.fileName.toLocal8Bit() + "]" );
+                if ( remaining > 0 && !file.seek( literal.size - remaining ) ) {
+                    file.close();
+                }
+            }
+        }
+#endif
+        // generic path, only one chunk is in memory at a time
+        while ( remaining > 0 && file.isOpen() ) {
+            const QByteArray chunk = file.read( qMin<qint64>( remaining, m_outputBatchSize ) );
+            if ( chunk.isEmpty() ) {
+                break;
+            }
+            writeOutput( chunk );
+            remaining -= chunk.size();
+        }
+    }
+
+    if ( remaining > 0 ) {
+        // We announced the literal size already, so the literal has to be completed
+        akError() << "Connection" << m_identifier << "failed to stream" << remaining << "bytes of payload file"
+                  << literal.fileName << ":" << file.errorString();
+        while ( remaining > 0 ) {
+            const QByteArray padding( qMin<qint64>( remaining, m_outputBatchSize ), ' ' );
+            writeOutput( padding );
+            remaining -= padding.size();
+        }
+    }
+}
+
+void Connection::waitForOutputQueueDrained()
+{
+    // don't block other clients while waiting for this one
+    const CommandThrottle::Suspender suspender;
+    QTime timer;
+    timer.start();
+    while ( m_socket->bytesToWrite() > m_outputLowWaterMark ) {
+        if ( !m_socket->waitForBytesWritten( 30 * 1000 ) ) {
+            akError() << "Connection" << m_identifier << "failed to write queued output:" << m_socket->errorString();
+            break;
+        }
+    }
+    QMutexLocker locker( &m_outputStatisticsLock );
+    m_outputStallTime += timer.elapsed();
+    ++m_outputStallCount;
+}
+
+void Connection::releaseIdleDatabase()
+{
+    if ( !m_backend ) {
+        m_backend = DataStore::self();
+    }
+    if ( m_backend->releaseConnection() ) {
+        akDebug() << "Connection" << m_identifier << "released idle database connection";
+    }
 }
 
 CommandContext *Connection::context() const
@@ -247,7 +481,26 @@ void Connection::slotResponseAvailable( const Response &response )
 {
     // FIXME handle reentrancy in the presence of continuation. Something like:
     // "if continuation pending, queue responses, once continuation is done, replay them"
-    writeOut( response.asString() );
+    if ( response.hasFileLiterals() ) {
+        writeStreamedResponse( response );
+        return;
+    }
+
+    if ( m_outputBuffer.isEmpty() ) {
+        m_outputBatchTime.start();
+        if ( m_outputFlushTimer ) {
+            m_outputFlushTimer->start();
+        }
+    }
+    response.appendTo( m_outputBuffer );
+
+    // Tagged responses finish a command and continuation responses wait for the
+    // client, so those have to go out immediately together with everything before them
+    if ( !response.isUntagged()
+         || m_outputBuffer.size() >= m_outputBatchSize
+         || m_outputBatchTime.elapsed() >= m_outputBatchInterval ) {
+        flushOutput();
+    }
 }
 
 void Connection::slotConnectionStateChange( ConnectionState state )
@@ -292,7 +545,10 @@ void Connection::flushStatusMessageQueue()
 
 void Connection::setSessionId( const QByteArray &id )
 {
-  m_identifier.sprintf( "%s (%p)", id.data(), static_cast<void *>( this ) );
+  {
+    QMutexLocker locker( &m_outputStatisticsLock );
+    m_identifier.sprintf( "%s (%p)", id.data(), static_cast<void *>( this ) );
+  }
   Tracer::self()->beginConnection( m_identifier, QString() );
   m_streamParser->setTracerIdentifier( m_identifier );
 
@@ -346,3 +602,18 @@ bool Connection::verifyCacheOnRetrieval() const
 {
   return m_verifyCacheOnRetrieval;
 }
+
+QVariantMap Connection::outputStatistics()
+{
+  QVariantMap statistics;
+  QMutexLocker locker( &sConnectionsLock );
+  Q_FOREACH ( const Connection *connection, sConnections ) {
+    QMutexLocker connectionLocker( &connection->m_outputStatisticsLock );
+    QVariantMap output;
+    output.insert( QLatin1String( "bytesQueued" ), connection->m_outputBytesQueued );
+    output.insert( QLatin1String( "stallCount" ), connection->m_outputStallCount );
+    output.insert( QLatin1String( "stallTime" ), connection->m_outputStallTime );
+    statistics.insert( connection->m_identifier, output );
+  }
+  return statistics;
+}
@@ -20,20 +20,25 @@
 #ifndef AKONADI_CONNECTION_H
 #define AKONADI_CONNECTION_H
 
+#include <QtCore/QMutex>
 #include <QtCore/QPointer>
 #include <QtCore/QThread>
+#include <QtCore/QTime>
+#include <QtCore/QVariant>
 #include <QtNetwork/QLocalSocket>
 
 #include "entities.h"
 #include "global.h"
 #include "clientcapabilities.h"
 #include "commandcontext.h"
+#include "response.h"
+
+class QTimer;
 
 namespace Akonadi {
 namespace Server {
 
 class Handler;
-class Response;
 class DataStore;
 class Collection;
 class ImapStreamParser;
@@ -75,6 +80,16 @@ public:
     /** Returns @c true if permanent cache verification is enabled. */
     bool verifyCacheOnRetrieval() const;
 
+    /**
+      Returns the output statistics of every client connection, keyed by its
+      identifier: the total amount of response data (in bytes) queued so far,
+      how many times the output queue exceeded the high-water mark, and how long
+      (in milliseconds) response producers were blocked in total, waiting for
+      the queue to drain below the low-water mark.
+      This method is thread-safe.
+    */
+    static QVariantMap outputStatistics();
+
 Q_SIGNALS:
     void disconnected();
 
@@ -87,10 +102,23 @@ protected Q_SLOTS:
 
     virtual void slotResponseAvailable( const Akonadi::Server::Response &response );
 
+    /**
+     * Writes all batched responses to the socket.
+     */
+    void flushOutput();
+
+    /**
+     * Releases the database connection of this thread when the client has been idle for a while.
+     */
+    void releaseIdleDatabase();
+
 protected:
     Connection(QObject *parent = 0); // used for testing
 
-    void writeOut( const QByteArray &data );
+    void waitForOutputQueueDrained();
+    void writeOutput( const QByteArray &data );
+    void writeStreamedResponse( const Akonadi::Server::Response &response );
+    void streamFileLiteral( const Akonadi::Server::Response::FileLiteral &literal );
     virtual Handler *findHandlerForCommand( const QByteArray &command );
 
 protected:
@@ -107,6 +135,20 @@ protected:
     bool m_verifyCacheOnRetrieval;
     CommandContext m_context;
 
+    QByteArray m_outputBuffer;
+    QTimer *m_outputFlushTimer;
+    QTime m_outputBatchTime;
+    int m_outputBatchSize;
+    int m_outputBatchInterval;
+    qint64 m_outputHighWaterMark;
+    qint64 m_outputLowWaterMark;
+    /// Protects the output statistics and the identifier, which are read by other threads
+    mutable QMutex m_outputStatisticsLock;
+    qint64 m_outputBytesQueued;
+    qint64 m_outputStallTime;
+    int m_outputStallCount;
+    QTimer *m_dbIdleTimer;
+
 };
 
 } // namespace Server
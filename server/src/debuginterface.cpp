@@ -20,6 +20,8 @@
 #include "debuginterface.h"
 #include "debuginterfaceadaptor.h"
 #include "tracer.h"
+#include "connection.h"
+#include "storage/itemretrievalmanager.h"
 #include <QtDBus>
 
 using namespace Akonadi::Server;
@@ -41,3 +43,28 @@ void DebugInterface::setTracer( const QString &tracer )
 {
   Tracer::self()->activateTracer( tracer );
 }
+
+QVariantMap DebugInterface::itemRetrievalQueues() const
+{
+  return ItemRetrievalManager::instance()->queueStatistics();
+}
+
+QVariantMap DebugInterface::itemRetrievalWaitTimes() const
+{
+  return ItemRetrievalManager::instance()->waitStatistics();
+}
+
+QVariantMap DebugInterface::itemRetrievalFailureCache() const
+{
+  return ItemRetrievalManager::instance()->failureCacheStatistics();
+}
+
+QVariantMap DebugInterface::itemRetrievalPrefetch() const
+{
+  return ItemRetrievalManager::instance()->prefetchStatistics();
+}
+
+QVariantMap DebugInterface::connectionOutput() const
+{
+  return Connection::outputStatistics();
+}
@@ -21,6 +21,7 @@
 #define AKONADI_DEBUGINTERFACE_H
 
 #include <QObject>
+#include <QVariant>
 
 namespace Akonadi {
 namespace Server {
@@ -40,6 +41,34 @@ class DebugInterface : public QObject
     Q_SCRIPTABLE QString tracer() const;
     Q_SCRIPTABLE void setTracer( const QString &tracer );
 
+    /**
+     * Returns the number of pending item retrieval requests and running
+     * retrieval jobs per resource.
+     */
+    Q_SCRIPTABLE QVariantMap itemRetrievalQueues() const;
+
+    /**
+     * Returns how long item retrieval requests waited in the queue,
+     * per priority class.
+     */
+    Q_SCRIPTABLE QVariantMap itemRetrievalWaitTimes() const;
+
+    /**
+     * Returns size, hits and misses of the cache of failed item retrievals.
+     */
+    Q_SCRIPTABLE QVariantMap itemRetrievalFailureCache() const;
+
+    /**
+     * Returns counters of the read-ahead prefetching of items.
+     */
+    Q_SCRIPTABLE QVariantMap itemRetrievalPrefetch() const;
+
+    /**
+     * Returns the amount of response data queued and the output stalls
+     * of every client connection.
+     */
+    Q_SCRIPTABLE QVariantMap connectionOutput() const;
+
 };
 
 } // namespace Server
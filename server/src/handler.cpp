@@ -21,6 +21,8 @@
 #include <QtCore/QDebug>
 #include <QtCore/QLatin1String>
 
+#include <algorithm>
+
 #include "libs/imapset_p.h"
 #include "libs/protocol_p.h"
 
@@ -29,6 +31,7 @@
 #include "scope.h"
 #include "handler/akappend.h"
 #include "handler/append.h"
+#include "handler/batchmerge.h"
 #include "handler/capability.h"
 #include "handler/copy.h"
 #include "handler/colcopy.h"
@@ -107,6 +110,133 @@ QByteArray Handler::tag() const
     return m_tag;
 }
 
+namespace {
+
+typedef Handler *( *HandlerFactory )( Scope::SelectionScope scope );
+
+template <typename T>
+Handler *createHandler( Scope::SelectionScope )
+{
+    return new T();
+}
+
+template <typename T>
+Handler *createScopedHandler( Scope::SelectionScope scope )
+{
+    return new T( scope );
+}
+
+Handler *createList( Scope::SelectionScope scope )
+{
+    return new List( scope, false );
+}
+
+Handler *createLsub( Scope::SelectionScope scope )
+{
+    return new List( scope, true );
+}
+
+Handler *createBegin( Scope::SelectionScope )
+{
+    return new TransactionHandler( TransactionHandler::Begin );
+}
+
+Handler *createRollback( Scope::SelectionScope )
+{
+    return new TransactionHandler( TransactionHandler::Rollback );
+}
+
+Handler *createCommit( Scope::SelectionScope )
+{
+    return new TransactionHandler( TransactionHandler::Commit );
+}
+
+Handler *createSubscribe( Scope::SelectionScope )
+{
+    return new Subscribe( true );
+}
+
+Handler *createUnsubscribe( Scope::SelectionScope )
+{
+    return new Subscribe( false );
+}
+
+Handler *createLink( Scope::SelectionScope scope )
+{
+    return new Link( scope, true );
+}
+
+Handler *createUnlink( Scope::SelectionScope scope )
+{
+    return new Link( scope, false );
+}
+
+struct CommandHandler
+{
+    const char *command;
+    HandlerFactory factory;
+};
+
+// Commands allowed in authenticated state, sorted by command name for binary search
+const CommandHandler sAuthenticatedCommands[] = {
+    { AKONADI_CMD_APPEND, &createHandler<Append> },
+    { AKONADI_CMD_BEGIN, &createBegin },
+    { AKONADI_CMD_COLLECTIONCOPY, &createHandler<ColCopy> },
+    { AKONADI_CMD_COLLECTIONMOVE, &createScopedHandler<ColMove> },
+    { AKONADI_CMD_COMMIT, &createCommit },
+    { AKONADI_CMD_ITEMCOPY, &createHandler<Copy> },
+    { AKONADI_CMD_COLLECTIONCREATE, &createScopedHandler<Create> },
+    { AKONADI_CMD_COLLECTIONDELETE, &createScopedHandler<Delete> },
+    { AKONADI_CMD_EXPUNGE, &createHandler<Expunge> }, //TODO: remove EXPUNGE support in Akonadi 2.0
+    { AKONADI_CMD_ITEMFETCH, &createScopedHandler<Fetch> },
+    { AKONADI_CMD_ITEMLINK, &createLink },
+    { AKONADI_CMD_LIST, &createList },
+    { AKONADI_CMD_LSUB, &createLsub },
+    { AKONADI_CMD_MERGE, &createHandler<Merge> },
+    { AKONADI_CMD_COLLECTIONMODIFY, &createScopedHandler<Modify> },
+    { AKONADI_CMD_ITEMMOVE, &createScopedHandler<Move> },
+    { AKONADI_CMD_ITEMDELETE, &createScopedHandler<Remove> },
+    { AKONADI_CMD_RESOURCESELECT, &createHandler<ResourceSelect> },
+    { AKONADI_CMD_ROLLBACK, &createRollback },
+    { AKONADI_CMD_SEARCH, &createHandler<Search> },
+    { AKONADI_CMD_SEARCH_RESULT, &createScopedHandler<SearchResult> },
+    { AKONADI_CMD_SEARCH_STORE, &createHandler<SearchPersistent> },
+    { AKONADI_CMD_SELECT, &createScopedHandler<Select> },
+    { AKONADI_CMD_STATUS, &createHandler<Status> },
+    { AKONADI_CMD_ITEMMODIFY, &createScopedHandler<Store> },
+    { AKONADI_CMD_SUBSCRIBE, &createSubscribe },
+    { AKONADI_CMD_TAGAPPEND, &createHandler<TagAppend> },
+    { AKONADI_CMD_TAGFETCH, &createScopedHandler<TagFetch> },
+    { AKONADI_CMD_TAGREMOVE, &createScopedHandler<TagRemove> },
+    { AKONADI_CMD_TAGSTORE, &createHandler<TagStore> },
+    { AKONADI_CMD_ITEMUNLINK, &createUnlink },
+    { AKONADI_CMD_UNSUBSCRIBE, &createUnsubscribe },
+    { AKONADI_CMD_ITEMCREATE, &createHandler<AkAppend> },
+    { AKONADI_CMD_ITEMBATCHMERGE, &createHandler<BatchMerge> },
+    { AKONADI_CMD_X_AKLIST, &createList }, //TODO: remove X-AKLIST support in Akonadi 2.0
+    { AKONADI_CMD_X_AKLSUB, &createLsub } //TODO: remove X-AKLSUB support in Akonadi 2.0
+};
+
+bool commandLessThan( const CommandHandler &handler, const char *command )
+{
+    return qstrcmp( handler.command, command ) < 0;
+}
+
+#ifndef QT_NO_DEBUG
+bool commandsSorted( const CommandHandler *begin, const CommandHandler *end )
+{
+    for ( const CommandHandler *it = begin + 1; it < end; ++it ) {
+        if ( qstrcmp( ( it - 1 )->command, it->command ) >= 0 ) {
+            qWarning() << "Command" << it->command << "is not sorted after" << ( it - 1 )->command;
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+}
+
 Handler *Handler::findHandlerForCommandAuthenticated( const QByteArray &_command, ImapStreamParser *streamParser )
 {
   QByteArray command( _command );
@@ -116,108 +246,18 @@ Handler *Handler::findHandlerForCommandAuthenticated( const QByteArray &_command
     command = streamParser->readString();
   }
 
-    // allowed commands are listed below ;-).
-    if ( command == AKONADI_CMD_APPEND ) {
-        return new Append();
-    }
-    if ( command == AKONADI_CMD_COLLECTIONCREATE ) {
-        return new Create( scope );
-    }
-    if ( command == AKONADI_CMD_LIST || command == AKONADI_CMD_X_AKLIST ) { //TODO: remove X-AKLIST support in Akonadi 2.0
-        return new List( scope, false );
-    }
-    if ( command == AKONADI_CMD_LSUB || command == AKONADI_CMD_X_AKLSUB ) { //TODO: remove X-AKLSUB support in Akonadi 2.0
-        return new List( scope, true );
-    }
-    if ( command == AKONADI_CMD_SELECT ) {
-        return new Select( scope );
-    }
-    if ( command == AKONADI_CMD_SEARCH_STORE ) {
-        return new SearchPersistent();
-    }
-    if ( command == AKONADI_CMD_SEARCH ) {
-        return new Search();
-    }
-    if ( command == AKONADI_CMD_SEARCH_RESULT ) {
-        return new SearchResult( scope );
-    }
-    if ( command == AKONADI_CMD_ITEMFETCH ) {
-        return new Fetch( scope );
-    }
-    if ( command == AKONADI_CMD_EXPUNGE ) { //TODO: remove EXPUNGE support in Akonadi 2.0
-        return new Expunge();
-    }
-    if ( command == AKONADI_CMD_ITEMMODIFY ) {
-        return new Store( scope );
-    }
-    if ( command == AKONADI_CMD_STATUS ) {
-        return new Status();
-    }
-    if ( command == AKONADI_CMD_COLLECTIONDELETE ) {
-      return new Delete( scope );
-    }
-    if ( command == AKONADI_CMD_COLLECTIONMODIFY ) {
-      return new Modify( scope );
-    }
-    if ( command == AKONADI_CMD_BEGIN ) {
-      return new TransactionHandler( TransactionHandler::Begin );
-    }
-    if ( command == AKONADI_CMD_ROLLBACK ) {
-      return new TransactionHandler( TransactionHandler::Rollback );
-    }
-    if ( command == AKONADI_CMD_COMMIT ) {
-      return new TransactionHandler( TransactionHandler::Commit );
-    }
-    if ( command == AKONADI_CMD_ITEMCREATE ) {
-      return new AkAppend();
-    }
-    if ( command == AKONADI_CMD_SUBSCRIBE ) {
-      return new Subscribe( true );
-    }
-    if ( command == AKONADI_CMD_UNSUBSCRIBE ) {
-      return new Subscribe( false );
-    }
-    if ( command == AKONADI_CMD_ITEMCOPY ) {
-      return new Copy();
-    }
-    if ( command == AKONADI_CMD_COLLECTIONCOPY ) {
-      return new ColCopy();
-    }
-    if ( command == AKONADI_CMD_ITEMLINK ) {
-      return new Link( scope, true );
-    }
-    if ( command == AKONADI_CMD_ITEMUNLINK ) {
-      return new Link( scope, false );
-    }
-    if ( command == AKONADI_CMD_RESOURCESELECT ) {
-      return new ResourceSelect();
-    }
-    if ( command == AKONADI_CMD_ITEMDELETE ) {
-      return new Remove( scope );
-    }
-    if ( command == AKONADI_CMD_ITEMMOVE ) {
-      return new Move( scope );
-    }
-    if ( command == AKONADI_CMD_COLLECTIONMOVE ) {
-      return new ColMove( scope );
-    }
-    if ( command == AKONADI_CMD_TAGAPPEND ) {
-      return new TagAppend();
-    }
-    if ( command == AKONADI_CMD_TAGFETCH ) {
-      return new TagFetch( scope );
-    }
-    if ( command == AKONADI_CMD_TAGREMOVE ) {
-      return new TagRemove( scope );
-    }
-    if ( command == AKONADI_CMD_TAGSTORE ) {
-      return new TagStore();
-    }
-    if ( command == AKONADI_CMD_MERGE ) {
-      return new Merge();
-    }
-
+  const CommandHandler *begin = sAuthenticatedCommands;
+  const CommandHandler *end = sAuthenticatedCommands + sizeof( sAuthenticatedCommands ) / sizeof( CommandHandler );
+#ifndef QT_NO_DEBUG
+  static const bool sSorted = commandsSorted( begin, end );
+  Q_ASSERT_X( sSorted, "Handler::findHandlerForCommandAuthenticated", "sAuthenticatedCommands is not sorted" );
+#endif
+  const CommandHandler *it = std::lower_bound( begin, end, command.constData(), commandLessThan );
+  if ( it == end || qstrcmp( it->command, command.constData() ) != 0 ) {
     return 0;
+  }
+
+  return it->factory( scope );
 }
 
 void Handler::setConnection( Connection *connection )
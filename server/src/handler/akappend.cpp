@@ -228,6 +228,8 @@ bool AkAppend::readParts( PimItem &pimItem )
 
   // chop up literal data in parts
   int pos = 0; // traverse through part data now
+  QVector<Part> parts;
+  parts.reserve( partSpecs.size() );
   QPair<QByteArray, QPair<qint64, int> > partSpec;
   Q_FOREACH ( partSpec, partSpecs ) {
     // wrap data into a part
@@ -239,14 +241,15 @@ bool AkAppend::readParts( PimItem &pimItem )
       part.setVersion( partSpec.second.second );
     }
     part.setDatasize( partSpec.second.first );
-
-    if ( !PartHelper::insert( &part ) ) {
-      return failureResponse( "Unable to append item part" );
-    }
+    parts << part;
 
     pos += partSpec.second.first;
   }
 
+  if ( !PartHelper::insert( parts ) ) {
+    return failureResponse( "Unable to append item part" );
+  }
+
   if ( realSize != pimItem.size() ) {
     pimItem.setSize( realSize );
     pimItem.update();
@@ -264,11 +267,23 @@ bool AkAppend::insertItem( PimItem &item, const Collection &parentCol,
     return failureResponse( "Failed to append item" );
   }
 
+  if ( !appendFlagsAndTags( PimItem::List() << item, parentCol, itemFlags, itemTagsRID, itemTagsGID ) ) {
+    return false;
+  }
+
+  return insertParts( item );
+}
+
+bool AkAppend::appendFlagsAndTags( const PimItem::List &items, const Collection &parentCol,
+                                   const QVector<QByteArray> &itemFlags,
+                                   const QVector<QByteArray> &itemTagsRID,
+                                   const QVector<QByteArray> &itemTagsGID )
+{
   // set message flags
   // This will hit an entry in cache inserted there in buildPimItem()
   const Flag::List flagList = HandlerHelper::resolveFlags( itemFlags );
   bool flagsChanged = false;
-  if ( !DataStore::self()->appendItemsFlags( PimItem::List() << item, flagList, &flagsChanged, false, parentCol, true ) ) {
+  if ( !DataStore::self()->appendItemsFlags( items, flagList, &flagsChanged, false, parentCol, true ) ) {
     return failureResponse( "Unable to append item flags." );
   }
 
@@ -280,10 +295,15 @@ bool AkAppend::insertItem( PimItem &item, const Collection &parentCol,
     tagList << HandlerHelper::resolveTagsByRID( itemTagsRID, connection()->context() );
   }
   bool tagsChanged;
-  if ( !DataStore::self()->appendItemsTags( PimItem::List() << item, tagList, &tagsChanged, false, parentCol, true ) ) {
+  if ( !DataStore::self()->appendItemsTags( items, tagList, &tagsChanged, false, parentCol, true ) ) {
     return failureResponse( "Unable to append item tags." );
   }
 
+  return true;
+}
+
+bool AkAppend::insertParts( PimItem &item )
+{
   // Handle individual parts
   qint64 partSizes = 0;
   if ( connection()->capabilities().akAppendStreaming() ) {
@@ -343,7 +363,7 @@ bool AkAppend::notify( const PimItem &item, const Collection &collection )
   return true;
 }
 
-bool AkAppend::sendResponse( const QByteArray &responseStr, const PimItem &item )
+void AkAppend::sendItemResponse( const PimItem &item )
 {
   // Date time is always stored in UTC time zone by the server.
   const QString datetime = QLocale::c().toString( item.datetime(), QLatin1String( "dd-MMM-yyyy hh:mm:ss +0000" ) );
@@ -353,7 +373,14 @@ bool AkAppend::sendResponse( const QByteArray &responseStr, const PimItem &item
   response.setUserDefined();
   response.setString( "[UIDNEXT " + QByteArray::number( item.id() ) + " DATETIME " + ImapParser::quote( datetime.toUtf8() ) + ']' );
   Q_EMIT responseAvailable( response );
+}
 
+bool AkAppend::sendResponse( const QByteArray &responseStr, const PimItem &item )
+{
+  sendItemResponse( item );
+
+  Response response;
+  response.setTag( tag() );
   response.setSuccess();
   response.setString( responseStr );
   Q_EMIT responseAvailable( response );
@@ -74,11 +74,24 @@ protected:
                      const QVector<QByteArray> &itemTagsRID,
                      const QVector<QByteArray> &itemTagsGID );
 
+    /// Sets the flags and tags of the newly inserted @p items, without notifications.
+    bool appendFlagsAndTags( const PimItem::List &items,
+                             const Collection &parentCollection,
+                             const QVector<QByteArray> &itemFlags,
+                             const QVector<QByteArray> &itemTagsRID,
+                             const QVector<QByteArray> &itemTagsGID );
+
+    /// Reads the parts of the newly inserted @p item from the stream and stores them.
+    bool insertParts( PimItem &item );
+
     bool readParts( PimItem &item );
 
     virtual bool notify( const PimItem &item, const Collection &collection );
     virtual bool sendResponse( const QByteArray &response, const PimItem &item );
 
+    /// Sends the UIDNEXT and DATETIME of @p item, without completing the command.
+    void sendItemResponse( const PimItem &item );
+
 
 private:
     QByteArray parseFlag( const QByteArray &flag ) const;
@@ -71,7 +71,7 @@ bool Append::commit()
         }
       } else {
         while ( !m_streamParser->atLiteralEnd() ) {
-          m_data += m_streamParser->readLiteralPart();
+          m_data += m_streamParser->readLiteralPartView();
         }
       }
     } else {
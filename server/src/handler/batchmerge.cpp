@@ -0,0 +1,180 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include "batchmerge.h"
+#include "imapstreamparser.h"
+#include "preprocessormanager.h"
+#include "storage/datastore.h"
+#include "storage/transaction.h"
+#include <response.h>
+#include <akdebug.h>
+
+#include <libs/protocol_p.h>
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+namespace {
+
+// New items sharing the same collection, flags and tags
+struct NewItems
+{
+    Collection collection;
+    QVector<QByteArray> flags;
+    QVector<QByteArray> tagsRID;
+    QVector<QByteArray> tagsGID;
+    PimItem::List items;
+};
+
+}
+
+BatchMerge::BatchMerge()
+  : Merge()
+{
+}
+
+BatchMerge::~BatchMerge()
+{
+}
+
+bool BatchMerge::parseStream()
+{
+    const QList<QByteArray> mergeParts = m_streamParser->readParenthesizedList();
+    const bool silent = mergeParts.contains( AKONADI_PARAM_SILENT );
+    // Without RID or GID there is nothing to merge with, all items are new
+    const bool lookup = mergeParts.contains( AKONADI_PARAM_GID ) || mergeParts.contains( AKONADI_PARAM_REMOTEID );
+
+    DataStore *db = DataStore::self();
+    Transaction transaction( db );
+
+    PimItem::List items;
+    PimItem::List appendedItems;
+    QVector<qint64> mergedIds;
+    QVector<NewItems> newItems;
+    // new item id -> index of its group in newItems, until its flags and tags are stored
+    QHash<qint64, int> pendingItems;
+
+    while ( !m_streamParser->atCommandEnd() ) {
+      Collection parentCol;
+      ChangedAttributes itemFlags, itemTagsRID, itemTagsGID;
+      PimItem item;
+      // Parse the next item, assuming X-AKAPPEND syntax
+      if ( !buildPimItem( item, parentCol, itemFlags, itemTagsRID, itemTagsGID ) ) {
+        return false;
+      }
+
+      const QVector<PimItem> result = lookup ? mergeCandidates( item, parentCol, mergeParts ) : QVector<PimItem>();
+      if ( result.count() == 0 ) {
+        if ( !item.insert() ) {
+          return failureResponse( "Failed to append item" );
+        }
+        if ( !insertParts( item ) ) {
+          return false;
+        }
+
+        // Flags and tags are stored once all items are known
+        QVector<NewItems>::iterator group = newItems.begin();
+        for ( ; group != newItems.end(); ++group ) {
+          if ( group->collection.id() == parentCol.id() && group->flags == itemFlags.added
+               && group->tagsRID == itemTagsRID.added && group->tagsGID == itemTagsGID.added ) {
+            break;
+          }
+        }
+        if ( group == newItems.end() ) {
+          NewItems newGroup;
+          newGroup.collection = parentCol;
+          newGroup.flags = itemFlags.added;
+          newGroup.tagsRID = itemTagsRID.added;
+          newGroup.tagsGID = itemTagsGID.added;
+          group = newItems.insert( newItems.end(), newGroup );
+        }
+        group->items << item;
+        pendingItems.insert( item.id(), group - newItems.begin() );
+
+        // Collected within the transaction, dispatched as one batch on commit
+        db->notificationCollector()->itemAdded( item, parentCol );
+        appendedItems << item;
+        items << item;
+
+      } else if ( result.count() == 1 ) {
+        PimItem existingItem = result.first();
+
+        // An item appended earlier in this batch needs its flags and tags stored
+        // before merging into it, the bulk insert would fail on rows added by
+        // mergeItem() otherwise
+        const QHash<qint64, int>::Iterator pending = pendingItems.find( existingItem.id() );
+        if ( pending != pendingItems.end() ) {
+          NewItems &group = newItems[pending.value()];
+          if ( !appendFlagsAndTags( group.items, group.collection, group.flags, group.tagsRID, group.tagsGID ) ) {
+            return false;
+          }
+          Q_FOREACH ( const PimItem &groupItem, group.items ) {
+            pendingItems.remove( groupItem.id() );
+          }
+          group.items.clear();
+        }
+
+        mChangedParts.clear();
+        if ( !mergeItem( item, existingItem, itemFlags, itemTagsRID, itemTagsGID ) ) {
+          return false;
+        }
+        notify( existingItem, parentCol );
+        mergedIds << existingItem.id();
+        items << existingItem;
+
+      } else {
+        akDebug() << "Multiple merge candidates:";
+        Q_FOREACH ( const PimItem &candidate, result ) {
+          akDebug() << "\t" << candidate.id() << candidate.remoteId() << candidate.gid();
+        }
+        return failureResponse( "Multiple merge candidates, aborting" );
+      }
+    }
+
+    Q_FOREACH ( const NewItems &group, newItems ) {
+      if ( !group.items.isEmpty() && !appendFlagsAndTags( group.items, group.collection, group.flags, group.tagsRID, group.tagsGID ) ) {
+        return false;
+      }
+    }
+
+    if ( !transaction.commit() ) {
+      return failureResponse( "Failed to commit transaction" );
+    }
+
+    if ( PreprocessorManager::instance()->isActive() ) {
+      Q_FOREACH ( const PimItem &item, appendedItems ) {
+        // enqueue the item for preprocessing
+        PreprocessorManager::instance()->beginHandleItem( item, db );
+      }
+    }
+
+    Q_FOREACH ( const PimItem &item, items ) {
+      sendItemResponse( item );
+    }
+    if ( !silent && !mergedIds.isEmpty() && !fetchMergedItems( mergedIds ) ) {
+      return failureResponse( "Failed to retrieve merged items" );
+    }
+
+    Response response;
+    response.setTag( tag() );
+    response.setSuccess();
+    response.setString( "Batch merge completed" );
+    Q_EMIT responseAvailable( response );
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef AKONADI_SERVER_BATCHMERGE_H
+#define AKONADI_SERVER_BATCHMERGE_H
+
+#include "handler/merge.h"
+
+namespace Akonadi {
+namespace Server {
+
+/**
+  @ingroup akonadi_server_handler
+
+  Handler for the X-AKBATCHMERGE command.
+
+  This command appends or merges any number of items in a single transaction,
+  so that resources synchronizing many items don't pay for a round-trip and
+  a commit per item.
+
+  Syntax:
+  x-akbatchmerge = "X-AKBATCHMERGE" SP "(" [merge-part *(SP merge-part)] ")" 1*(SP x-akappend-arguments)
+  merge-part = "GID" / "RID" / "SILENT"
+
+  Each item is merged like with the MERGE command, or appended like with
+  X-AKAPPEND when it has no merge candidate. Flags and tags of the new items
+  are stored with one statement per distinct set of flags and tags, and the
+  change notifications of all items are emitted as one batch on commit.
+
+  The UIDNEXT and DATETIME of every item are reported in the order of the
+  command, followed by the full FETCH responses of the merged items unless
+  SILENT was given.
+ */
+class BatchMerge : public Merge
+{
+    Q_OBJECT
+
+public:
+    BatchMerge();
+
+    ~BatchMerge();
+
+    bool parseStream();
+};
+
+} // namespace Server
+} // namespace Akonadi
+
+#endif // AKONADI_SERVER_BATCHMERGE_H
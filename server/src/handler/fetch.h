@@ -36,9 +36,11 @@ namespace Server {
   @verbatim
   fetch-request = tag " " [scope-selector " "] "FETCH " scope " " fetch-parameters " " part-list
   scope-selector = [ "UID" / "RID" ]
-  fetch-parameters = [ "FULLPAYLOAD" / "CACHEONLY" / "CACHEONLY" / "EXTERNALPAYLOAD" / "ANCESTORS " depth ]
+  fetch-parameters = [ "FULLPAYLOAD" / "CACHEONLY" / "CACHEONLY" / "EXTERNALPAYLOAD" / "ANCESTORS " depth / "LIMIT " limit / "CONTINUE " token ]
   part-list = "(" *(part-id) ")"
   depth = "0" / "1" / "INF"
+  limit = 1*DIGIT
+  token = astring
   @endverbatim
 
   Semantics:
@@ -46,6 +48,11 @@ namespace Server {
   - @c CACHEONLY: Restrict retrieval to parts already in the cache, even if more parts have been requested.
   - @c EXTERNALPAYLOAD: Indicate the capability to retrieve parts via the filesystem instead over the socket
   - @c ANCESTORS: Indicate the desired ancestor collection depth (0 is the default)
+  - @c LIMIT: Return at most @c limit items, starting with the highest id. Must be between 1 and 2^31 - 1.
+    If more items are left, the item responses are followed by an untagged @c CONTINUE response with
+    the token for the next page.
+  - @c CONTINUE: Continue with the page following the one @c token was returned for. Requires @c LIMIT,
+    the token is rejected if the command scope or context differs from the one of the previous page.
  */
 class Fetch : public Handler
 {
@@ -19,6 +19,8 @@
 
 #include "fetchhelper.h"
 
+#include "accesstimeupdater.h"
+#include "agentmetadatacache.h"
 #include "akdebug.h"
 #include "akdbus.h"
 #include "akonadi.h"
@@ -38,10 +40,12 @@
 #include "storage/transaction.h"
 #include "utils.h"
 #include "intervalcheck.h"
+#include "itemattributeserializer.h"
 #include "agentmanagerinterface.h"
 #include "dbusconnectionpool.h"
 #include "tagfetchhelper.h"
 
+#include <QtCore/QFileInfo>
 #include <QtCore/QLocale>
 #include <QtCore/QStringList>
 #include <QtCore/QUuid>
@@ -50,10 +54,17 @@
 #include <QtSql/QSqlDatabase>
 #include <QtSql/QSqlError>
 #include <QtSql/QSqlQuery>
+#include <QtSql/QSqlRecord>
 
 using namespace Akonadi;
 using namespace Akonadi::Server;
 
+// Inline parts of at least this size are sent as separate response fragments
+#define PART_STREAMING_THRESHOLD ( 64 * 1024 ) // 64 kB
+
+// Initial capacity of an item response, enough for the attributes of a typical item
+#define ITEM_RESPONSE_RESERVE_SIZE 512
+
 FetchHelper::FetchHelper( Connection *connection, const Scope &scope, const FetchScope &fetchScope )
   : mStreamParser( 0 )
   , mConnection( connection )
@@ -115,6 +126,9 @@ QSqlQuery FetchHelper::buildPartQuery( const QVector<QByteArray> &partList, bool
 
     ItemQueryHelper::scopeToQuery( mScope, mConnection->context(), partQuery );
 
+    // don't keep the payload of already processed rows around
+    partQuery.setForwardOnly( true );
+
     if ( !partQuery.exec() ) {
       throw HandlerException( "Unable to list item parts" );
     }
@@ -288,6 +302,12 @@ bool FetchHelper::isScopeLocal( const Scope &scope )
   query.next();
   const QString resourceName = query.value( 0 ).toString();
 
+  AgentMetadataCache::AgentInfo info;
+  AgentMetadataCache *cache = AkonadiServer::instance()->agentMetadataCache();
+  if ( cache && cache->agentInfo( resourceName, info ) ) {
+    return info.hasLocalStorage;
+  }
+
   org::freedesktop::Akonadi::AgentManager manager( AkDBus::serviceName( AkDBus::Control ),
                                                    QLatin1String( "/AgentManager" ),
                                                    DBusConnectionPool::threadConnection() );
@@ -296,25 +316,165 @@ bool FetchHelper::isScopeLocal( const Scope &scope )
   return properties.value( QLatin1String( "HasLocalStorage" ), false ).toBool();
 }
 
-QByteArray FetchHelper::tagsToByteArray( const Tag::List &tags )
+void FetchHelper::prefetchTags()
+{
+  // Serialize all tags of the fetched items up front, instead of querying
+  // each tag and its attributes again for every item carrying it
+  QueryBuilder tagQuery( PimItem::tableName() );
+  tagQuery.addJoin( QueryBuilder::InnerJoin, PimItemTagRelation::tableName(),
+                    PimItem::idFullColumnName(), PimItemTagRelation::leftFullColumnName() );
+  tagQuery.addJoin( QueryBuilder::InnerJoin, Tag::tableName(),
+                    Tag::idFullColumnName(), PimItemTagRelation::rightFullColumnName() );
+  tagQuery.addJoin( QueryBuilder::InnerJoin, TagType::tableName(),
+                    Tag::typeIdFullColumnName(), TagType::idFullColumnName() );
+  tagQuery.addColumn( Tag::idFullColumnName() );
+  tagQuery.addColumn( Tag::gidFullColumnName() );
+  tagQuery.addColumn( Tag::parentIdFullColumnName() );
+  tagQuery.addColumn( TagType::nameFullColumnName() );
+  tagQuery.setDistinct( true );
+
+  ItemQueryHelper::scopeToQuery( mScope, mConnection->context(), tagQuery );
+
+  if ( !tagQuery.exec() ) {
+    throw HandlerException( "Unable to retrieve item tags" );
+  }
+
+  QSqlQuery query = tagQuery.query();
+  QVector<qint64> tagIds;
+  QList<QSqlRecord> tagRecords;
+  while ( query.next() ) {
+    const qint64 tagId = query.value( 0 ).toLongLong();
+    if ( !mTagCache.contains( tagId ) ) {
+      tagIds << tagId;
+      tagRecords << query.record();
+    }
+  }
+  if ( tagIds.isEmpty() ) {
+    return;
+  }
+
+  ImapSet tagSet;
+  tagSet.add( tagIds );
+  const QHash<qint64, QList<QByteArray> > attributes = TagFetchHelper::fetchTagAttributes( tagSet );
+
+  for ( int i = 0; i < tagIds.size(); ++i ) {
+    const QSqlRecord &record = tagRecords.at( i );
+    const qint64 tagId = tagIds.at( i );
+    mTagCache.insert( tagId, TagFetchHelper::tagToByteArray( tagId,
+                                                             record.value( 1 ).toString().toLatin1(),
+                                                             record.value( 2 ).toLongLong(),
+                                                             record.value( 3 ).toString().toLatin1(),
+                                                             QByteArray(),
+                                                             attributes.value( tagId ) ) );
+  }
+}
+
+QByteArray FetchHelper::tagsToByteArray( const QVector<qint64> &tagIds )
 {
   QByteArray b;
-  QList<QByteArray> attributes;
   b += "(";
-  Q_FOREACH ( const Tag &tag, tags ) {
-    b += "(" + TagFetchHelper::tagToByteArray( tag.id(),
-                                               tag.gid().toLatin1(),
-                                               tag.parentId(),
-                                               tag.tagType().name().toLatin1(),
-                                               QByteArray(),
-                                               TagFetchHelper::fetchTagAttributes( tag.id() ) ) + ") ";
+  Q_FOREACH ( qint64 tagId, tagIds ) {
+    QHash<qint64, QByteArray>::ConstIterator it = mTagCache.constFind( tagId );
+    if ( it == mTagCache.constEnd() ) {
+      // tagged after prefetchTags() ran
+      const Tag tag = Tag::retrieveById( tagId );
+      it = mTagCache.insert( tagId, TagFetchHelper::tagToByteArray( tag.id(),
+                                                                   tag.gid().toLatin1(),
+                                                                   tag.parentId(),
+                                                                   tag.tagType().name().toLatin1(),
+                                                                   QByteArray(),
+                                                                   TagFetchHelper::fetchTagAttributes( tag.id() ) ) );
+    }
+    b += '(';
+    b += it.value();
+    b += ") ";
   }
   b += ")";
   return b;
 }
 
+QByteArray FetchHelper::scopeHash() const
+{
+  // identifies the item set a continuation token belongs to
+  const CommandContext *context = mConnection->context();
+  QByteArray scope = QByteArray::number( mScope.scope() ) + ' ' + mScope.uidSet().toImapSequenceSet() + ' ';
+  scope += mScope.ridSet().join( QLatin1String( "\n" ) ).toUtf8() + ' ';
+  scope += mScope.ridChain().join( QLatin1String( "\n" ) ).toUtf8() + ' ';
+  scope += mScope.gidSet().join( QLatin1String( "\n" ) ).toUtf8() + ' ';
+  scope += QByteArray::number( context->collectionId() ) + ' ' + QByteArray::number( context->tagId() ) + ' ';
+  scope += QByteArray::number( context->resource().id() ) + ' ';
+  if ( mFetchScope.changedSince().isValid() ) {
+    scope += QByteArray::number( mFetchScope.changedSince().toTime_t() );
+  }
+  return QByteArray::number( qHash( scope ), 16 );
+}
+
+bool FetchHelper::restrictScopeToPage()
+{
+  const QByteArray hash = scopeHash();
+
+  // the token is "<last item id>:<scope hash>"
+  qint64 lastId = -1;
+  const QByteArray token = mFetchScope.continuationToken();
+  if ( !token.isEmpty() ) {
+    const int separator = token.indexOf( ':' );
+    bool ok = false;
+    lastId = token.left( separator ).toLongLong( &ok );
+    if ( separator < 0 || !ok || token.mid( separator + 1 ) != hash ) {
+      throw HandlerException( "Invalid continuation token" );
+    }
+  }
+
+  // Items are returned ordered by descending id, find the ids of the next page
+  QueryBuilder pageQuery( PimItem::tableName() );
+  pageQuery.addColumn( PimItem::idFullColumnName() );
+  ItemQueryHelper::scopeToQuery( mScope, mConnection->context(), pageQuery );
+  if ( mFetchScope.changedSince().isValid() ) {
+    pageQuery.addValueCondition( PimItem::datetimeFullColumnName(), Query::GreaterOrEqual, mFetchScope.changedSince().toUTC() );
+  }
+  if ( lastId >= 0 ) {
+    pageQuery.addValueCondition( PimItem::idFullColumnName(), Query::Less, lastId );
+  }
+  pageQuery.addSortColumn( PimItem::idFullColumnName(), Query::Descending );
+  pageQuery.setLimit( mFetchScope.limit() );
+  if ( !pageQuery.exec() ) {
+    throw HandlerException( "Unable to list items" );
+  }
+
+  QVector<qint64> ids;
+  ids.reserve( mFetchScope.limit() );
+  QSqlQuery query = pageQuery.query();
+  while ( query.next() ) {
+    ids << query.value( 0 ).toLongLong();
+  }
+  query.finish();
+
+  if ( ids.isEmpty() ) {
+    return false;
+  }
+  if ( ids.count() == mFetchScope.limit() ) {
+    mNextContinuationToken = QByteArray::number( ids.last() ) + ':' + hash;
+  }
+
+  // All further queries only look at the items of this page
+  ImapSet set;
+  set.add( ids );
+  mScope = Scope( Scope::Uid );
+  mScope.setUidSet( set );
+  return true;
+}
+
 bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
 {
+  // trigger a collection sync if configured to do so, this has to happen
+  // before the scope is restricted to the ids of a single page
+  triggerOnDemandFetch();
+
+  if ( mFetchScope.limit() > 0 && !restrictScopeToPage() ) {
+    // nothing left to fetch
+    return true;
+  }
+
   // retrieve missing parts
   // HACK: isScopeLocal() is a workaround for resources that have cache expiration
   // because when the cache expires, Baloo is not able to content of the items. So
@@ -323,9 +483,6 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
   // is painfully slow with many items and is generally designed to fetch a few
   // messages, not all of them. In the long term, we need a better way to do this.
   if ( !mFetchScope.cacheOnly() || isScopeLocal( mScope ) ) {
-    // trigger a collection sync if configured to do so
-    triggerOnDemandFetch();
-
     // Prepare for a call to ItemRetriever::exec();
     // From a resource perspective the only parts that can be fetched are payloads.
     ItemRetriever retriever( mConnection );
@@ -333,6 +490,9 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
     retriever.setRetrieveParts( mFetchScope.requestedPayloads() );
     retriever.setRetrieveFullPayload( mFetchScope.fullPayload() );
     retriever.setChangedSince( mFetchScope.changedSince() );
+    if ( mFetchScope.background() ) {
+      retriever.setPriority( ItemRetrievalRequest::BackgroundPriority );
+    }
     if ( !retriever.exec() && !mFetchScope.ignoreErrors() ) { // There we go, retrieve the missing parts from the resource.
       if ( mConnection->context()->resource().isValid() ) {
         throw HandlerException( QString::fromLatin1( "Unable to fetch item from backend (collection %1, resource %2) : %3" )
@@ -382,6 +542,9 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
   QSqlQuery tagQuery;
   if ( mFetchScope.tagsRequested() ) {
     tagQuery = buildTagQuery();
+    if ( !mFetchScope.tagFetchScope().isEmpty() ) {
+      prefetchTags();
+    }
   }
 
   QSqlQuery vRefQuery;
@@ -389,48 +552,65 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
     vRefQuery = buildVRefQuery();
   }
 
+  // the item attributes to send only depend on the fetch scope, so determine them once
+  ItemAttributeSerializer serializer;
+  serializer.addColumn( AKONADI_PARAM_UID, mItemQueryColumnMap[ItemQueryPimItemIdColumn], ItemAttributeSerializer::NumberValue );
+  serializer.addColumn( AKONADI_PARAM_REVISION, mItemQueryColumnMap[ItemQueryRevColumn], ItemAttributeSerializer::NumberValue );
+  if ( mFetchScope.remoteIdRequested() ) {
+    serializer.addColumn( AKONADI_PARAM_REMOTEID, mItemQueryColumnMap[ItemQueryPimItemRidColumn], ItemAttributeSerializer::StringValue );
+  }
+  serializer.addColumn( AKONADI_PARAM_MIMETYPE, mItemQueryColumnMap[ItemQueryMimeTypeColumn], ItemAttributeSerializer::StringValue );
+  serializer.addColumn( AKONADI_PARAM_COLLECTIONID, mItemQueryColumnMap[ItemQueryCollectionIdColumn], ItemAttributeSerializer::NumberValue );
+  if ( mFetchScope.sizeRequested() ) {
+    serializer.addColumn( AKONADI_PARAM_SIZE, mItemQueryColumnMap[ItemQuerySizeColumn], ItemAttributeSerializer::NumberValue );
+  }
+  if ( mFetchScope.mTimeRequested() ) {
+    serializer.addColumn( AKONADI_PARAM_MTIME, mItemQueryColumnMap[ItemQueryDatetimeColumn], ItemAttributeSerializer::DateTimeValue );
+  }
+  if ( mFetchScope.remoteRevisionRequested() ) {
+    serializer.addColumn( AKONADI_PARAM_REMOTEREVISION, mItemQueryColumnMap[ItemQueryRemoteRevisionColumn], ItemAttributeSerializer::OptionalStringValue );
+  }
+  if ( mFetchScope.gidRequested() ) {
+    serializer.addColumn( AKONADI_PARAM_GID, mItemQueryColumnMap[ItemQueryPimItemGidColumn], ItemAttributeSerializer::OptionalStringValue );
+  }
+
+  const bool flagsRequested = mFetchScope.flagsRequested();
+  const bool tagsRequested = mFetchScope.tagsRequested();
+  //We don't take the fetch scope into account yet. It's either id only or the full tag.
+  const bool fullTagsRequested = !mFetchScope.tagFetchScope().isEmpty();
+  const bool virtualReferencesRequested = mFetchScope.virtualReferencesRequested();
+  const int ancestorDepth = mFetchScope.ancestorDepth();
+  const bool checkCachedPayloadPartsOnly = mFetchScope.checkCachedPayloadPartsOnly();
+  const bool ignoreErrors = mFetchScope.ignoreErrors();
+  const bool allPartsRequested = mFetchScope.fullPayload() || mFetchScope.allAttributes();
+  const bool externalPayloadSupported = mFetchScope.externalPayloadSupported();
+  const bool noPayloadPath = mConnection->capabilities().noPayloadPath();
+  // update atime (only if the payload was actually requested, otherwise a simple resource sync prevents cache clearing)
+  const bool accessTimeUpdateNeeded = needsAccessTimeUpdate( mFetchScope.requestedParts() ) || mFetchScope.fullPayload();
+  QVector<qint64> accessedItems;
+
   // build responses
   Response response;
   response.setUntagged();
   while ( itemQuery.isValid() ) {
     const qint64 pimItemId = extractQueryResult( itemQuery, ItemQueryPimItemIdColumn ).toLongLong();
-    const int pimItemRev = extractQueryResult( itemQuery, ItemQueryRevColumn ).toInt();
-
-    QList<QByteArray> attributes;
-    attributes.append( AKONADI_PARAM_UID " " + QByteArray::number( pimItemId ) );
-    attributes.append( AKONADI_PARAM_REVISION " " + QByteArray::number( pimItemRev ) );
-    if ( mFetchScope.remoteIdRequested() ) {
-      attributes.append( AKONADI_PARAM_REMOTEID " " + ImapParser::quote( Utils::variantToByteArray( extractQueryResult( itemQuery, ItemQueryPimItemRidColumn ) ) ) );
+    const Collection::Id parentCollectionId = extractQueryResult( itemQuery, ItemQueryCollectionIdColumn ).toLongLong();
+    if ( accessTimeUpdateNeeded ) {
+      accessedItems << pimItemId;
     }
-    attributes.append( AKONADI_PARAM_MIMETYPE " " + ImapParser::quote( Utils::variantToByteArray( extractQueryResult( itemQuery, ItemQueryMimeTypeColumn ) ) ) );
-    Collection::Id parentCollectionId = extractQueryResult( itemQuery, ItemQueryCollectionIdColumn ).toLongLong();
-    attributes.append( AKONADI_PARAM_COLLECTIONID " " + QByteArray::number( parentCollectionId ) );
 
-    if ( mFetchScope.sizeRequested() ) {
-      const qint64 pimItemSize = extractQueryResult( itemQuery, ItemQuerySizeColumn ).toLongLong();
-      attributes.append( AKONADI_PARAM_SIZE " " + QByteArray::number( pimItemSize ) );
-    }
-    if ( mFetchScope.mTimeRequested() ) {
-      const QDateTime pimItemDatetime = extractQueryResult( itemQuery, ItemQueryDatetimeColumn ).toDateTime();
-      // Date time is always stored in UTC time zone by the server.
-      QString datetime = QLocale::c().toString( pimItemDatetime, QLatin1String( "dd-MMM-yyyy hh:mm:ss +0000" ) );
-      attributes.append( AKONADI_PARAM_MTIME " " + ImapParser::quote( datetime.toUtf8() ) );
-    }
-    if ( mFetchScope.remoteRevisionRequested() ) {
-      const QByteArray rrev = Utils::variantToByteArray( extractQueryResult( itemQuery, ItemQueryRemoteRevisionColumn ) );
-      if ( !rrev.isEmpty() ) {
-        attributes.append( AKONADI_PARAM_REMOTEREVISION " " + ImapParser::quote( rrev ) );
-      }
-    }
-    if ( mFetchScope.gidRequested() ) {
-      const QByteArray gid = Utils::variantToByteArray( extractQueryResult( itemQuery, ItemQueryPimItemGidColumn ) );
-      if ( !gid.isEmpty() ) {
-        attributes.append( AKONADI_PARAM_GID " " + ImapParser::quote( gid ) );
-      }
-    }
-
-    if ( mFetchScope.flagsRequested() ) {
-      QList<QByteArray> flags;
+    // IMAP protocol violation: should actually be the sequence number
+    QByteArray attr;
+    attr.reserve( ITEM_RESPONSE_RESERVE_SIZE );
+    attr += QByteArray::number( pimItemId );
+    attr += ' ';
+    attr += responseIdentifier;
+    attr += " (";
+    serializer.serialize( itemQuery, attr );
+
+    if ( flagsRequested ) {
+      attr += " " AKONADI_PARAM_FLAGS " (";
+      bool firstFlag = true;
       while ( flagQuery.isValid() ) {
         const qint64 id = flagQuery.value( FlagQueryIdColumn ).toLongLong();
         if ( id > pimItemId ) {
@@ -439,17 +619,19 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
         } else if ( id < pimItemId ) {
           break;
         }
-        flags << Utils::variantToByteArray( flagQuery.value( FlagQueryNameColumn ) );
+        if ( !firstFlag ) {
+          attr += ' ';
+        }
+        attr += Utils::variantToByteArray( flagQuery.value( FlagQueryNameColumn ) );
+        firstFlag = false;
         flagQuery.next();
       }
-      attributes.append( AKONADI_PARAM_FLAGS " (" + ImapParser::join( flags, " " ) + ')' );
+      attr += ')';
     }
 
-    if ( mFetchScope.tagsRequested() ) {
+    if ( tagsRequested ) {
       ImapSet tags;
       QVector<qint64> tagIds;
-      //We don't take the fetch scope into account yet. It's either id only or the full tag.
-      const bool fullTagsRequested = !mFetchScope.tagFetchScope().isEmpty();
       while ( tagQuery.isValid() ) {
         const qint64 id = tagQuery.value( TagQueryItemIdColumn ).toLongLong();
         if ( id > pimItemId ) {
@@ -466,18 +648,16 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
       }
       if ( !fullTagsRequested ) {
         if ( !tags.isEmpty() ) {
-          attributes.append( AKONADI_PARAM_TAGS " " + tags.toImapSequenceSet() );
+          attr += " " AKONADI_PARAM_TAGS " ";
+          attr += tags.toImapSequenceSet();
         }
       } else {
-        Tag::List tagList;
-        Q_FOREACH ( qint64 t, tagIds ) {
-          tagList << Tag::retrieveById( t );
-        }
-        attributes.append( AKONADI_PARAM_TAGS " " + tagsToByteArray( tagList ) );
+        attr += " " AKONADI_PARAM_TAGS " ";
+        attr += tagsToByteArray( tagIds );
       }
     }
 
-    if ( mFetchScope.virtualReferencesRequested() ) {
+    if ( virtualReferencesRequested ) {
       ImapSet cols;
       while ( vRefQuery.isValid() ) {
           const qint64 id = vRefQuery.value( VRefQueryItemIdColumn ).toLongLong();
@@ -492,17 +672,25 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
           vRefQuery.next();
       }
       if ( !cols.isEmpty() ) {
-        attributes.append( AKONADI_PARAM_VIRTREF " " + cols.toImapSequenceSet() );
+        attr += " " AKONADI_PARAM_VIRTREF " ";
+        attr += cols.toImapSequenceSet();
       }
     }
 
-    if ( mFetchScope.ancestorDepth() > 0 ) {
-      attributes.append( HandlerHelper::ancestorsToByteArray( mFetchScope.ancestorDepth(), ancestorsForItem( parentCollectionId ) ) );
+    if ( ancestorDepth > 0 ) {
+      attr += ' ';
+      attr += HandlerHelper::ancestorsToByteArray( ancestorDepth, ancestorsForItem( parentCollectionId ) );
     }
 
     bool skipItem = false;
 
+    // the response up to and including each large part, which are sent on
+    // their own once the item is known to be complete
+    QList<QByteArray> fragments;
+
     QList<QByteArray> cachedParts;
+    // external parts whose content is streamed from the file to the client
+    QList<QPair<QByteArray, QString> > streamedParts;
 
     while ( partQuery.isValid() ) {
       const qint64 id = partQuery.value( PartQueryPimIdColumn ).toLongLong();
@@ -517,13 +705,13 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
       QByteArray part = partName;
       QByteArray data = Utils::variantToByteArray( partQuery.value( PartQueryDataColumn ) );
 
-      if ( mFetchScope.checkCachedPayloadPartsOnly() ) {
+      if ( checkCachedPayloadPartsOnly ) {
         if ( !data.isEmpty() ) {
           cachedParts << part;
         }
         partQuery.next();
      } else {
-        if ( mFetchScope.ignoreErrors() && data.isEmpty() ) {
+        if ( ignoreErrors && data.isEmpty() ) {
           //We wanted the payload, couldn't get it, and are ignoring errors. Skip the item.
           //This is not an error though, it's fine to have empty payload parts (to denote existing but not cached parts)
           //akDebug() << "item" << id << "has an empty payload part in parttable for part" << partName;
@@ -531,14 +719,33 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
           break;
         }
         const bool partIsExternal = partQuery.value( PartQueryExternalColumn ).toBool();
-        if ( !mFetchScope.externalPayloadSupported() && partIsExternal ) { //external payload not supported by the client, translate the data
-          data = PartHelper::translateData( data, partIsExternal );
+        const bool partRequested = allPartsRequested || mFetchScope.requestedParts().contains( partName );
+        QString streamedFileName;
+        if ( !externalPayloadSupported && partIsExternal ) { //external payload not supported by the client, translate the data
+          // stream the file to the client instead of reading it into memory
+          const QFileInfo fileInfo( PartHelper::resolveAbsolutePath( data ) );
+          if ( fileInfo.isReadable() && fileInfo.size() > 0 ) {
+            streamedFileName = fileInfo.absoluteFilePath();
+          } else if ( partRequested ) {
+            data = PartHelper::translateData( data, partIsExternal );
+          }
         }
         int version = partQuery.value( PartQueryVersionColumn ).toInt();
         if ( version != 0 ) { // '0' is the default, so don't send it
           part += '[' + QByteArray::number( version ) + ']';
         }
-        if (  mFetchScope.externalPayloadSupported() && partIsExternal ) { // external data and this is supported by the client
+        if ( !streamedFileName.isEmpty() ) {
+          if ( partRequested ) {
+            streamedParts.append( qMakePair( part, streamedFileName ) );
+          }
+          partQuery.next();
+          continue;
+        }
+        if ( !partRequested ) {
+          partQuery.next();
+          continue;
+        }
+        if ( externalPayloadSupported && partIsExternal ) { // external data and this is supported by the client
           part += " [FILE] ";
         }
         if ( data.isNull() ) {
@@ -547,17 +754,29 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
           part += " \"\"";
         } else {
           if ( partIsExternal ) {
-            if ( !mConnection->capabilities().noPayloadPath() ) {
+            if ( !noPayloadPath ) {
               data = PartHelper::resolveAbsolutePath( data ).toLocal8Bit();
             }
           }
 
           part += " {" + QByteArray::number( data.length() ) + "}\r\n";
-          part += data;
+
+          if ( data.length() >= PART_STREAMING_THRESHOLD ) {
+            // Keep the large part apart from the response, so it does not
+            // have to be copied into it
+            attr += ' ';
+            attr += part;
+            fragments << attr << data;
+            attr.clear();
+            partQuery.next();
+            continue;
+          }
         }
 
-        if ( mFetchScope.requestedParts().contains( partName ) || mFetchScope.fullPayload() || mFetchScope.allAttributes() ) {
-          attributes << part;
+        attr += ' ';
+        attr += part;
+        if ( !data.isEmpty() ) {
+          attr += data;
         }
 
         partQuery.next();
@@ -569,28 +788,62 @@ bool FetchHelper::fetchItems( const QByteArray &responseIdentifier )
       continue;
     }
 
-    if ( mFetchScope.checkCachedPayloadPartsOnly() ) {
-      attributes.append( AKONADI_PARAM_CACHEDPARTS " (" + ImapParser::join( cachedParts, " " ) + ')' );
+    // Nothing of the item has been sent before this point, skipping it or
+    // throwing would leave an unterminated response otherwise
+    bool fragmentSent = false;
+    Q_FOREACH ( const QByteArray &fragment, fragments ) {
+      emitItemFragment( fragment, fragmentSent );
+    }
+
+    if ( checkCachedPayloadPartsOnly ) {
+      attr += " " AKONADI_PARAM_CACHEDPARTS " (";
+      attr += ImapParser::join( cachedParts, " " );
+      attr += ')';
     }
 
-    // IMAP protocol violation: should actually be the sequence number
-    QByteArray attr = QByteArray::number( pimItemId ) + ' ' + responseIdentifier + " (";
-    attr += ImapParser::join( attributes, " " ) + ')';
     response.setUntagged();
+    response.setContinued( fragmentSent );
     response.setString( attr );
+    for ( int i = 0; i < streamedParts.size(); ++i ) {
+      const QFileInfo fileInfo( streamedParts.at( i ).second );
+      response.appendString( ' ' + streamedParts.at( i ).first + ' ' );
+      response.appendFileLiteral( fileInfo.absoluteFilePath(), fileInfo.size() );
+    }
+    response.appendString( ")" );
     Q_EMIT responseAvailable( response );
 
     itemQuery.next();
   }
 
-  // update atime (only if the payload was actually requested, otherwise a simple resource sync prevents cache clearing)
-  if ( needsAccessTimeUpdate( mFetchScope.requestedParts() ) || mFetchScope.fullPayload() ) {
-    updateItemAccessTime();
+  if ( !mNextContinuationToken.isEmpty() ) {
+    response.setUntagged();
+    response.setContinued( false );
+    response.setString( AKONADI_PARAM_CONTINUE " " + mNextContinuationToken );
+    Q_EMIT responseAvailable( response );
+  }
+
+  if ( accessTimeUpdateNeeded ) {
+    if ( AccessTimeUpdater *updater = AkonadiServer::instance()->accessTimeUpdater() ) {
+      updater->itemsAccessed( accessedItems );
+    } else {
+      updateItemAccessTime();
+    }
   }
 
   return true;
 }
 
+void FetchHelper::emitItemFragment( const QByteArray &fragment, bool &fragmentSent )
+{
+  Response response;
+  response.setUntagged();
+  response.setContinued( fragmentSent );
+  response.setPartial( true );
+  response.setString( fragment );
+  Q_EMIT responseAvailable( response );
+  fragmentSent = true;
+}
+
 bool FetchHelper::needsAccessTimeUpdate( const QVector<QByteArray> &parts )
 {
   // TODO technically we should compare the part list with the cache policy of
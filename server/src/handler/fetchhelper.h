@@ -76,7 +76,11 @@ class FetchHelper : public QObject
     static bool needsAccessTimeUpdate( const QVector<QByteArray> &parts );
     QVariant extractQueryResult( const QSqlQuery &query, ItemQueryColumns column ) const;
     bool isScopeLocal( const Scope &scope );
-    static QByteArray tagsToByteArray(const Tag::List &tags);
+    void prefetchTags();
+    QByteArray tagsToByteArray( const QVector<qint64> &tagIds );
+    void emitItemFragment( const QByteArray &fragment, bool &fragmentSent );
+    QByteArray scopeHash() const;
+    bool restrictScopeToPage();
 
   private:
     ImapStreamParser *mStreamParser;
@@ -86,6 +90,9 @@ class FetchHelper : public QObject
     Scope mScope;
     FetchScope mFetchScope;
     int mItemQueryColumnMap[ItemQueryColumnCount];
+    QByteArray mNextContinuationToken;
+    // serialized full tags, valid for the duration of the command
+    QHash<qint64, QByteArray> mTagCache;
 
     friend class ::FetchHelperTest;
 };
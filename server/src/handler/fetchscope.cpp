@@ -23,6 +23,8 @@
 #include "handlerhelper.h"
 #include "handler.h"
 
+#include <climits>
+
 using namespace Akonadi::Server;
 
 class FetchScope::Private : public QSharedData
@@ -50,12 +52,15 @@ class FetchScope::Private : public QSharedData
     uint mExternalPayloadSupported : 1;
     uint mRemoteRevisionRequested : 1;
     uint mIgnoreErrors : 1;
+    uint mBackground : 1;
     uint mFlagsRequested : 1;
     uint mRemoteIdRequested : 1;
     uint mGidRequested : 1;
     uint mTagsRequested : 1;
     uint mVirtRefRequested: 1;
     QVector<QByteArray> mTagFetchScope;
+    int mLimit;
+    QByteArray mContinuationToken;
 };
 
 FetchScope::Private::Private()
@@ -71,11 +76,13 @@ FetchScope::Private::Private()
   , mExternalPayloadSupported( false )
   , mRemoteRevisionRequested( false )
   , mIgnoreErrors( false )
+  , mBackground( false )
   , mFlagsRequested( false )
   , mRemoteIdRequested( false )
   , mGidRequested( false )
   , mTagsRequested( false )
   , mVirtRefRequested( false )
+  , mLimit( 0 )
 {
 }
 
@@ -95,12 +102,15 @@ FetchScope::Private::Private( const Private &other )
   , mExternalPayloadSupported( other.mExternalPayloadSupported )
   , mRemoteRevisionRequested( other.mRemoteRevisionRequested )
   , mIgnoreErrors( other.mIgnoreErrors )
+  , mBackground( other.mBackground )
   , mFlagsRequested( other.mFlagsRequested )
   , mRemoteIdRequested( other.mRemoteIdRequested )
   , mGidRequested( other.mGidRequested )
   , mTagsRequested( other.mTagsRequested )
   , mVirtRefRequested( other.mVirtRefRequested )
   , mTagFetchScope( other.mTagFetchScope )
+  , mLimit( other.mLimit )
+  , mContinuationToken( other.mContinuationToken )
 {
 }
 
@@ -134,17 +144,32 @@ void FetchScope::Private::parseCommandStream()
         mAncestorDepth = HandlerHelper::parseDepth( mStreamParser->readString() );
       } else if ( buffer == AKONADI_PARAM_IGNOREERRORS ) {
         mIgnoreErrors = true;
+      } else if ( buffer == AKONADI_PARAM_BACKGROUND ) {
+        mBackground = true;
       } else if ( buffer == AKONADI_PARAM_CHANGEDSINCE ) {
         bool ok = false;
         mChangedSince = QDateTime::fromTime_t( mStreamParser->readNumber( &ok ) );
         if ( !ok ) {
           throw HandlerException( "Invalid CHANGEDSINCE timestamp" );
         }
+      } else if ( buffer == AKONADI_PARAM_LIMIT ) {
+        bool ok = false;
+        const qint64 limit = mStreamParser->readNumber( &ok );
+        if ( !ok || limit <= 0 || limit > INT_MAX ) {
+          throw HandlerException( "Invalid LIMIT" );
+        }
+        mLimit = limit;
+      } else if ( buffer == AKONADI_PARAM_CONTINUE ) {
+        mContinuationToken = mStreamParser->readString();
       } else {
         throw HandlerException( "Invalid command argument" );
       }
     }
   }
+
+  if ( !mContinuationToken.isEmpty() && mLimit == 0 ) {
+    throw HandlerException( "CONTINUE requires LIMIT" );
+  }
 }
 
 void FetchScope::Private::parsePartList()
@@ -359,6 +384,16 @@ bool FetchScope::ignoreErrors() const
   return d->mIgnoreErrors;
 }
 
+void FetchScope::setBackground( bool background )
+{
+  d->mBackground = background;
+}
+
+bool FetchScope::background() const
+{
+  return d->mBackground;
+}
+
 void FetchScope::setFlagsRequested( bool flagsRequested )
 {
   d->mFlagsRequested = flagsRequested;
@@ -413,3 +448,23 @@ bool FetchScope::virtualReferencesRequested() const
 {
   return d->mVirtRefRequested;
 }
+
+void FetchScope::setLimit( int limit )
+{
+  d->mLimit = limit;
+}
+
+int FetchScope::limit() const
+{
+  return d->mLimit;
+}
+
+void FetchScope::setContinuationToken( const QByteArray &token )
+{
+  d->mContinuationToken = token;
+}
+
+QByteArray FetchScope::continuationToken() const
+{
+  return d->mContinuationToken;
+}
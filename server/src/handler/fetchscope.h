@@ -70,6 +70,9 @@ class FetchScope
     bool remoteRevisionRequested() const;
     void setIgnoreErrors( bool ignoreErrors );
     bool ignoreErrors() const;
+    /** Missing parts are retrieved with background priority. */
+    void setBackground( bool background );
+    bool background() const;
     void setFlagsRequested( bool flagsRequested );
     bool flagsRequested() const;
     void setRemoteIdRequested( bool remoteIdRequested );
@@ -81,6 +84,12 @@ class FetchScope
     QVector<QByteArray> tagFetchScope() const;
     void setVirtualReferencesRequested( bool vRefRequested );
     bool virtualReferencesRequested() const;
+    /** Maximum number of items to return, 0 for no limit. */
+    void setLimit( int limit );
+    int limit() const;
+    /** Token returned with the previous page of a paginated fetch. */
+    void setContinuationToken( const QByteArray &token );
+    QByteArray continuationToken() const;
 
   private:
     class Private;
@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include "itemattributeserializer.h"
+#include "libs/imapparser_p.h"
+#include "utils.h"
+
+#include <QtCore/QDateTime>
+#include <QtCore/QLocale>
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+ItemAttributeSerializer::ItemAttributeSerializer()
+{
+}
+
+void ItemAttributeSerializer::addColumn( const QByteArray &name, int column, ValueType type )
+{
+  Column c;
+  if ( !mColumns.isEmpty() ) {
+    c.prefix += ' ';
+  }
+  c.prefix += name + ' ';
+  c.index = column;
+  c.type = type;
+  mColumns.append( c );
+}
+
+int ItemAttributeSerializer::columnCount() const
+{
+  return mColumns.size();
+}
+
+void ItemAttributeSerializer::appendValue( const Column &column, const QVariant &value, QByteArray &buffer )
+{
+  switch ( column.type ) {
+    case NumberValue:
+      buffer += column.prefix;
+      buffer += QByteArray::number( value.toLongLong() );
+      break;
+    case StringValue:
+      buffer += column.prefix;
+      buffer += ImapParser::quote( Utils::variantToByteArray( value ) );
+      break;
+    case OptionalStringValue: {
+      const QByteArray string = Utils::variantToByteArray( value );
+      if ( !string.isEmpty() ) {
+        buffer += column.prefix;
+        buffer += ImapParser::quote( string );
+      }
+      break;
+    }
+    case DateTimeValue: {
+      // Date time is always stored in UTC time zone by the server.
+      const QString datetime = QLocale::c().toString( value.toDateTime(), QLatin1String( "dd-MMM-yyyy hh:mm:ss +0000" ) );
+      buffer += column.prefix;
+      buffer += ImapParser::quote( datetime.toUtf8() );
+      break;
+    }
+  }
+}
@@ -0,0 +1,93 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef AKONADI_ITEMATTRIBUTESERIALIZER_H
+#define AKONADI_ITEMATTRIBUTESERIALIZER_H
+
+#include <QByteArray>
+#include <QVariant>
+#include <QVector>
+
+namespace Akonadi {
+namespace Server {
+
+/**
+ * Serializes the per-item attributes of a FETCH response (UID, REV, REMOTEID, ...).
+ *
+ * The columns to serialize are added once for a given fetch scope, so that
+ * serializing an item only walks the resulting plan and appends the values
+ * directly to the output buffer, without testing the fetch scope or building
+ * temporary attribute lists for every row.
+ *
+ * The attributes are separated by a single space, the output does not start
+ * with one. The first column must therefore not be an optional one.
+ */
+class ItemAttributeSerializer
+{
+  public:
+    enum ValueType {
+      NumberValue,          ///< integer value
+      StringValue,          ///< quoted string value
+      OptionalStringValue,  ///< quoted string value, omitted when empty
+      DateTimeValue         ///< quoted date time in UTC
+    };
+
+    ItemAttributeSerializer();
+
+    /**
+     * Appends the attribute @p name to the plan, its value is read from
+     * column @p column of the serialized rows.
+     */
+    void addColumn( const QByteArray &name, int column, ValueType type );
+
+    /**
+     * Returns the number of columns in the plan.
+     */
+    int columnCount() const;
+
+    /**
+     * Appends the attributes of @p row to @p buffer. @p row can be anything
+     * providing QVariant value( int column ) const, usually a QSqlQuery.
+     */
+    template <typename Row>
+    void serialize( const Row &row, QByteArray &buffer ) const
+    {
+      const Column *column = mColumns.constData();
+      const Column *end = column + mColumns.size();
+      for ( ; column != end; ++column ) {
+        appendValue( *column, row.value( column->index ), buffer );
+      }
+    }
+
+  private:
+    struct Column {
+      QByteArray prefix;
+      int index;
+      ValueType type;
+    };
+
+    static void appendValue( const Column &column, const QVariant &value, QByteArray &buffer );
+
+    QVector<Column> mColumns;
+};
+
+} // namespace Server
+} // namespace Akonadi
+
+#endif
@@ -213,6 +213,30 @@ bool Merge::mergeItem( PimItem &newItem, PimItem &currentItem,
     return true;
 }
 
+QVector<PimItem> Merge::mergeCandidates( const PimItem &item, const Collection &parentCol,
+                                         const QList<QByteArray> &mergeParts )
+{
+    // Merging is always restricted to the same collection and mimetype
+    SelectQueryBuilder<PimItem> qb;
+    qb.addValueCondition( PimItem::collectionIdColumn(), Query::Equals, parentCol.id() );
+    qb.addValueCondition( PimItem::mimeTypeIdColumn(), Query::Equals, item.mimeTypeId() );
+    Q_FOREACH ( const QByteArray &part, mergeParts ) {
+      if ( part == AKONADI_PARAM_GID ) {
+        qb.addValueCondition( PimItem::gidColumn(), Query::Equals, item.gid() );
+      } else if ( part == AKONADI_PARAM_REMOTEID ) {
+        qb.addValueCondition( PimItem::remoteIdColumn(), Query::Equals, item.remoteId() );
+      } else if ( part != AKONADI_PARAM_SILENT ) {
+        throw HandlerException( "Only merging by RID or GID is allowed" );
+      }
+    }
+
+    if ( !qb.exec() ) {
+      throw HandlerException( "Failed to query database for item" );
+    }
+
+    return qb.result();
+}
+
 bool Merge::notify( const PimItem &item, const Collection &collection )
 {
     if ( !mChangedParts.isEmpty() ) {
@@ -222,10 +246,10 @@ bool Merge::notify( const PimItem &item, const Collection &collection )
     return true;
 }
 
-bool Merge::sendResponse( const QByteArray &responseStr, const PimItem &item )
+bool Merge::fetchMergedItems( const QVector<qint64> &ids )
 {
     ImapSet set;
-    set.add( QVector<qint64>() << item.id() );
+    set.add( ids );
     Scope scope( Scope::Uid );
     scope.setUidSet( set );
 
@@ -247,7 +271,12 @@ bool Merge::sendResponse( const QByteArray &responseStr, const PimItem &item )
     FetchHelper fetch( connection(), scope, fetchScope );
     connect( &fetch, SIGNAL(responseAvailable(Akonadi::Server::Response)),
              this, SIGNAL(responseAvailable(Akonadi::Server::Response)) );
-    if ( !fetch.fetchItems( AKONADI_CMD_ITEMFETCH ) ) {
+    return fetch.fetchItems( AKONADI_CMD_ITEMFETCH );
+}
+
+bool Merge::sendResponse( const QByteArray &responseStr, const PimItem &item )
+{
+    if ( !fetchMergedItems( QVector<qint64>() << item.id() ) ) {
       return failureResponse( "Failed to retrieve merged item" );
     }
 
@@ -274,29 +303,9 @@ bool Merge::parseStream()
       return false;
     }
 
-    bool silent = false;
-
-    // Merging is always restricted to the same collection and mimetype
-    SelectQueryBuilder<PimItem> qb;
-    qb.addValueCondition( PimItem::collectionIdColumn(), Query::Equals, parentCol.id() );
-    qb.addValueCondition( PimItem::mimeTypeIdColumn(), Query::Equals, item.mimeTypeId() );
-    Q_FOREACH ( const QByteArray &part, mergeParts ) {
-      if ( part == AKONADI_PARAM_GID ) {
-        qb.addValueCondition( PimItem::gidColumn(), Query::Equals, item.gid() );
-      } else if ( part == AKONADI_PARAM_REMOTEID ) {
-        qb.addValueCondition( PimItem::remoteIdColumn(), Query::Equals, item.remoteId() );
-      } else if ( part == AKONADI_PARAM_SILENT ) {
-        silent = true;
-      } else {
-        throw HandlerException( "Only merging by RID or GID is allowed" );
-      }
-    }
-
-    if ( !qb.exec() ) {
-      return failureResponse( "Failed to query database for item" );
-    }
+    const bool silent = mergeParts.contains( AKONADI_PARAM_SILENT );
 
-    QVector<PimItem> result = qb.result();
+    const QVector<PimItem> result = mergeCandidates( item, parentCol, mergeParts );
     if ( result.count() == 0 ) {
       // No item with such GID/RID exists, so call AkAppend::insert() and behave
       // like if this was a new item
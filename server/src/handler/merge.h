@@ -42,10 +42,16 @@ protected:
                     const ChangedAttributes &itemTagsRID,
                     const ChangedAttributes &itemTagsGID );
 
+    /// Returns the items in @p collection matching @p item by the RID or GID listed in @p mergeParts.
+    QVector<PimItem> mergeCandidates( const PimItem &item, const Collection &collection,
+                                      const QList<QByteArray> &mergeParts );
+
+    /// Sends the full FETCH response for each of the merged items @p ids.
+    bool fetchMergedItems( const QVector<qint64> &ids );
+
     bool notify( const PimItem &item, const Collection &collection );
     bool sendResponse( const QByteArray &response, const PimItem &item );
 
-private:
     QSet<QByteArray> mChangedParts;
 };
 
@@ -38,7 +38,7 @@ TagFetchHelper::TagFetchHelper( Connection *connection, const ImapSet &set )
 {
 }
 
-QSqlQuery TagFetchHelper::buildAttributeQuery() const
+QSqlQuery TagFetchHelper::buildAttributeQuery( const ImapSet &set )
 {
   QueryBuilder qb( TagAttribute::tableName() );
   qb.addColumn( TagAttribute::tagIdColumn() );
@@ -46,7 +46,7 @@ QSqlQuery TagFetchHelper::buildAttributeQuery() const
   qb.addColumn( TagAttribute::valueColumn() );
   qb.addSortColumn( TagAttribute::tagIdColumn(), Query::Descending );
 
-  QueryHelper::setToQuery( mSet, TagAttribute::tagIdColumn(), qb );
+  QueryHelper::setToQuery( set, TagAttribute::tagIdColumn(), qb );
 
   if ( !qb.exec() ) {
     throw HandlerException( "Unable to list tag attributes" );
@@ -119,6 +119,22 @@ QList<QByteArray> TagFetchHelper::fetchTagAttributes( qint64 tagId )
   return attributes;
 }
 
+QHash<qint64, QList<QByteArray> > TagFetchHelper::fetchTagAttributes( const ImapSet &tagIds )
+{
+  QHash<qint64, QList<QByteArray> > attributes;
+
+  QSqlQuery attributeQuery = buildAttributeQuery( tagIds );
+  while ( attributeQuery.isValid() ) {
+    const qint64 tagId = attributeQuery.value( 0 ).toLongLong();
+    const QByteArray attrName = attributeQuery.value( 1 ).toByteArray();
+    const QByteArray attrValue = attributeQuery.value( 2 ).toByteArray();
+
+    attributes[tagId] << attrName << ImapParser::quote( attrValue );
+    attributeQuery.next();
+  }
+  return attributes;
+}
+
 QByteArray TagFetchHelper::tagToByteArray(qint64 tagId, const QByteArray &gid, qint64 parentId, const QByteArray &type, const QByteArray &remoteId, const QList<QByteArray> &tagAttributes)
 {
   QList<QByteArray> attributes;
@@ -139,7 +155,7 @@ bool TagFetchHelper::fetchTags(const QByteArray& responseIdentifier)
 {
 
   QSqlQuery tagQuery = buildTagQuery();
-  QSqlQuery attributeQuery = buildAttributeQuery();
+  QSqlQuery attributeQuery = buildAttributeQuery( mSet );
 
   Response response;
   response.setUntagged();
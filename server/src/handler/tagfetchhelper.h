@@ -20,6 +20,7 @@
 #ifndef AKONADI_TAGFETCHHELPER_H
 #define AKONADI_TAGFETCHHELPER_H
 
+#include <QtCore/QHash>
 #include <QtCore/QObject>
 #include <QtSql/QSqlQuery>
 
@@ -46,6 +47,10 @@ class TagFetchHelper : public QObject
     bool fetchTags( const QByteArray &responseIdentifier );
 
     static QList<QByteArray> fetchTagAttributes( qint64 tagId );
+    /**
+     * Returns the attributes of all tags in @p tagIds, retrieved by a single query.
+     */
+    static QHash<qint64, QList<QByteArray> > fetchTagAttributes( const ImapSet &tagIds );
     static QByteArray tagToByteArray( qint64 tagId, const QByteArray &gid, qint64 parentId, const QByteArray &type, const QByteArray &remoteId, const QList<QByteArray> &tagAttributes );
 
   Q_SIGNALS:
@@ -53,7 +58,7 @@ class TagFetchHelper : public QObject
 
   private:
     QSqlQuery buildTagQuery();
-    QSqlQuery buildAttributeQuery() const;
+    static QSqlQuery buildAttributeQuery( const ImapSet &set );
     static QSqlQuery buildAttributeQuery( qint64 id );
 
   private:
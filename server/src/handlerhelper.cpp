@@ -116,6 +116,10 @@ int HandlerHelper::parseCachePolicy( const QByteArray &data, Collection &col, in
       const QString parts = partsList.join( QLatin1String( " " ) );
       somethingElseChanged = somethingElseChanged || col.cachePolicyLocalParts() != parts;
       col.setCachePolicyLocalParts( parts );
+    } else if ( key == AKONADI_PARAM_PREFETCH ) {
+      const int prefetch = qMax( 0, value.toInt() );
+      somethingElseChanged = somethingElseChanged || prefetch != col.cachePolicyPrefetch();
+      col.setCachePolicyPrefetch( prefetch );
     }
   }
 
@@ -134,6 +138,10 @@ QByteArray HandlerHelper::cachePolicyToByteArray( const Collection &col )
   rv += " " AKONADI_PARAM_CACHETIMEOUT " " + QByteArray::number( col.cachePolicyCacheTimeout() );
   rv += " " AKONADI_PARAM_SYNCONDEMAND " " + ( col.cachePolicySyncOnDemand() ? QByteArray( "true" ) : QByteArray( "false" ) );
   rv += " " AKONADI_PARAM_LOCALPARTS " (" + col.cachePolicyLocalParts().toLatin1() + ')';
+  // optional, to keep the response unchanged for clients not knowing about it
+  if ( col.cachePolicyPrefetch() > 0 ) {
+    rv += " " AKONADI_PARAM_PREFETCH " " + QByteArray::number( col.cachePolicyPrefetch() );
+  }
   rv += ')';
   return rv;
 }
@@ -21,6 +21,7 @@
 #include "imapstreamparser.h"
 #include "response.h"
 #include "tracer.h"
+#include "commandthrottle.h"
 
 #include <QtCore/QDateTime>
 #include <QtCore/QDebug>
@@ -31,6 +32,11 @@
 using namespace Akonadi;
 using namespace Akonadi::Server;
 
+// Processed data is dropped from the receive buffer when it exceeds this size
+// and makes up most of the buffer, so that large literals are not moved around
+// after every chunk that has been read
+#define COMPACTION_THRESHOLD ( 64 * 1024 ) // 64 kB
+
 ImapStreamParser::ImapStreamParser( QIODevice *socket )
   : m_socket( socket )
   , m_position( 0 )
@@ -71,8 +77,11 @@ QByteArray ImapStreamParser::readString()
   // literal string
   // TODO: error handling
   if ( hasLiteral() ) {
+    // The literal size is announced by the client, only trust it as far as
+    // the data has arrived already and let the buffer grow with the rest
+    result.reserve( qMin<qint64>( m_literalSize, m_data.length() - m_position ) );
     while ( !atLiteralEnd() ) {
-      result += readLiteralPart();
+      result += readLiteralPartView();
     }
     return result;
   }
@@ -183,9 +192,30 @@ QByteArray ImapStreamParser::readLiteralPart()
   m_literalSize -= size;
   Q_ASSERT( m_literalSize >= 0 );
   if ( !m_peeking ) {
-    m_data = m_data.right( m_data.size() - m_position );
-    m_position = 0;
+    discardProcessedData();
+  }
+  return result;
+}
+
+QByteArray ImapStreamParser::readLiteralPartView()
+{
+  if ( m_literalSize == 0 ) {
+    return QByteArray();
+  }
+
+  if ( !m_peeking ) {
+    // the previously returned view is no longer in use
+    discardProcessedData();
   }
+  if ( !waitForMoreData( m_data.length() <= m_position ) ) {
+    throw ImapParserException( "Unable to read more data" );
+  }
+
+  const int size = qMin<qint64>( m_literalSize, m_data.length() - m_position );
+  const QByteArray result = QByteArray::fromRawData( m_data.constData() + m_position, size );
+  m_position += size;
+  m_literalSize -= size;
+  Q_ASSERT( m_literalSize >= 0 );
   return result;
 }
 
@@ -587,14 +617,21 @@ QByteArray ImapStreamParser::parseQuotedString()
         continue;
       }
 
+      // copy the run of plain characters at once instead of char by char
+      int runEnd = i;
+      while ( runEnd < m_data.length() && m_data.at( runEnd ) != '\\' && m_data.at( runEnd ) != '"' ) {
+        ++runEnd;
+      }
+      result.append( m_data.constData() + i, runEnd - i );
+      i = runEnd;
+      if ( i >= m_data.length() ) {
+        continue;
+      }
+
       if ( m_data[i] == '"' ) {
         end = i + 1; // skip the '"'
         break;
       }
-
-      result += m_data[i];
-
-      ++i;
     }
   }
 
@@ -698,12 +735,14 @@ void ImapStreamParser::stripLeadingSpaces()
 bool ImapStreamParser::waitForMoreData( bool wait )
 {
    if ( wait ) {
-     if ( m_socket->bytesAvailable() > 0 ||
-          m_socket->waitForReadyRead( m_timeout ) ) {
-        m_data.append( m_socket->readAll() );
-     } else {
-       return false;
+     if ( m_socket->bytesAvailable() == 0 ) {
+       // don't keep other clients waiting while this one sends its data
+       const CommandThrottle::Suspender suspender;
+       if ( !m_socket->waitForReadyRead( m_timeout ) ) {
+         return false;
+       }
      }
+     m_data.append( m_socket->readAll() );
    }
    return true;
 }
@@ -718,6 +757,22 @@ QByteArray ImapStreamParser::readRemainingData()
   return m_data.mid( m_position );
 }
 
+bool ImapStreamParser::hasRemainingData() const
+{
+  return m_position < m_data.length();
+}
+
+void ImapStreamParser::discardProcessedData()
+{
+  if ( m_position >= m_data.length() ) {
+    m_data.clear();
+    m_position = 0;
+  } else if ( m_position >= COMPACTION_THRESHOLD && m_position >= m_data.length() / 2 ) {
+    m_data.remove( 0, m_position );
+    m_position = 0;
+  }
+}
+
 bool ImapStreamParser::atCommandEnd()
 {
   if ( !waitForMoreData( m_position >= m_data.length() ) ) {
@@ -734,8 +789,7 @@ bool ImapStreamParser::atCommandEnd()
     }
     // We'd better empty m_data from time to time before it grows out of control
     if ( !m_peeking ) {
-      m_data = m_data.right( m_data.size() - m_position );
-      m_position = 0;
+      discardProcessedData();
     }
     return true; //command end
   }
@@ -796,8 +850,7 @@ QByteArray ImapStreamParser::readUntilCommandEnd()
   m_position = i + 1;
   // We'd better empty m_data from time to time before it grows out of control
   if ( !m_peeking ) {
-    m_data = m_data.right( m_data.size() - m_position );
-    m_position = 0;
+    discardProcessedData();
   }
   return result;
 }
@@ -818,8 +871,7 @@ void ImapStreamParser::skipCurrentCommand()
   m_position = i + 1;
   // We'd better empty m_data from time to time before it grows out of control
   if ( !m_peeking ) {
-    m_data = m_data.right( m_data.size() - m_position );
-    m_position = 0;
+    discardProcessedData();
   }
 }
 
@@ -149,6 +149,21 @@ class ImapStreamParser
      */
     QByteArray readLiteralPart();
 
+    /**
+     * Same as readLiteralPart(), but returns all literal data already buffered
+     * (at least one byte) without copying it.
+     *
+     * The returned array references the parser's receive buffer and is only
+     * valid until the next call to the parser. Callers that need to keep the
+     * data must copy it, appending it to another QByteArray or writing it to a
+     * file does not need a copy.
+     *
+     * This call might block.
+     *
+     * @return part of a literal data, referencing the parser's buffer
+     */
+    QByteArray readLiteralPartView();
+
     /**
      * Check if the literal data end was reached. See @ref hasLiteral and @ref readLiteralPart .
      * @return true if the literal was completely read.
@@ -228,6 +243,12 @@ class ImapStreamParser
      */
     QByteArray readRemainingData();
 
+    /**
+     * Returns whether there is data that was read from the socket, but not processed yet.
+     * Unlike readRemainingData() this does not copy the data.
+     */
+    bool hasRemainingData() const;
+
     void setData( const QByteArray &data );
 
     /**
@@ -261,6 +282,13 @@ class ImapStreamParser
   private:
     QByteArray parseQuotedString();
 
+    /**
+     * Drops already processed data from the receive buffer. To avoid moving
+     * large amounts of data around, this only happens once the buffer has
+     * been consumed completely or the processed data dominates the buffer.
+     */
+    void discardProcessedData();
+
     /**
      * If the condition is true, wait for more data to be available from the socket.
      * If no data comes after a timeout (30000ms), it aborts and returns false.
@@ -18,6 +18,7 @@
  ***************************************************************************/
 #include "response.h"
 
+#include <QtCore/QFile>
 #include <QtCore/QTextStream>
 
 using namespace Akonadi::Server;
@@ -29,6 +30,8 @@ static const char *s_resultCodeStrings[] = {
 Response::Response()
     : m_resultCode( OK )
     , m_tag( "*" )
+    , m_partial( false )
+    , m_continued( false )
 {
 }
 
@@ -38,16 +41,80 @@ Response::~Response()
 
 QByteArray Response::asString() const
 {
-    QByteArray b = m_tag;
-    if ( m_tag != "*" && m_tag != "+" && m_resultCode != USER ) {
-        b += ' ';
-        b += s_resultCodeStrings[m_resultCode];
+    QByteArray b;
+    appendPrefixTo( b );
+    if ( m_fileLiterals.isEmpty() ) {
+        b += m_responseString;
+    } else {
+        appendResponseString( b );
     }
-    b += ' ';
-    b += m_responseString;
     return b;
 }
 
+void Response::appendTo( QByteArray &buffer ) const
+{
+    appendPrefixTo( buffer );
+    if ( m_fileLiterals.isEmpty() ) {
+        buffer += m_responseString;
+    } else {
+        appendResponseString( buffer );
+    }
+    if ( !m_partial ) {
+        buffer += "\r\n";
+    }
+}
+
+void Response::appendTo( QByteArray &buffer, QVector<FileLiteral> &fileLiterals ) const
+{
+    appendPrefixTo( buffer );
+    const int offset = buffer.size();
+    buffer += m_responseString;
+    if ( !m_partial ) {
+        buffer += "\r\n";
+    }
+
+    Q_FOREACH ( FileLiteral literal, m_fileLiterals ) {
+        literal.position += offset;
+        fileLiterals.append( literal );
+    }
+}
+
+void Response::appendPrefixTo( QByteArray &buffer ) const
+{
+    if ( m_continued ) {
+        return;
+    }
+    buffer += m_tag;
+    if ( m_tag != "*" && m_tag != "+" && m_resultCode != USER ) {
+        buffer += ' ';
+        buffer += s_resultCodeStrings[m_resultCode];
+    }
+    buffer += ' ';
+}
+
+void Response::appendResponseString( QByteArray &buffer ) const
+{
+    // File literals are only ever streamed by Connection, everywhere else the
+    // response is merely traced or inspected, so don't read the files for that
+    int pos = 0;
+    Q_FOREACH ( const FileLiteral &literal, m_fileLiterals ) {
+        buffer += m_responseString.mid( pos, literal.position - pos );
+        buffer += '[' + QByteArray::number( literal.size ) + " bytes from " + QFile::encodeName( literal.fileName ) + ']';
+        pos = literal.position;
+    }
+    buffer += m_responseString.mid( pos );
+}
+
+bool Response::isUntagged() const
+{
+    return m_tag == "*";
+}
+
+bool Response::hasFileLiterals() const
+{
+    return !m_fileLiterals.isEmpty();
+}
+
 Response::ResultCode Response::resultCode() const
 {
   return m_resultCode;
@@ -83,14 +150,42 @@ void Response::setContinuation()
     m_tag = QByteArray( 1, '+' );
 }
 
+void Response::setPartial( bool partial )
+{
+    m_partial = partial;
+}
+
+void Response::setContinued( bool continued )
+{
+    m_continued = continued;
+}
+
 void Response::setString( const QByteArray &string )
 {
     m_responseString = string;
+    m_fileLiterals.clear();
+}
+
+void Response::appendString( const QByteArray &string )
+{
+    m_responseString += string;
+}
+
+void Response::appendFileLiteral( const QString &fileName, qint64 size )
+{
+    m_responseString += '{' + QByteArray::number( size ) + "}\r\n";
+
+    FileLiteral literal;
+    literal.position = m_responseString.size();
+    literal.fileName = fileName;
+    literal.size = size;
+    m_fileLiterals.append( literal );
 }
 
 void Response::setString( const char *string )
 {
     m_responseString = QByteArray( string );
+    m_fileLiterals.clear();
 }
 
 void Response::setBye()
@@ -21,6 +21,8 @@
 
 #include <QByteArray>
 #include <QMetaType>
+#include <QString>
+#include <QVector>
 
 namespace Akonadi {
 namespace Server {
@@ -46,25 +48,89 @@ public:
 
     ResultCode resultCode() const;
 
-    /** The response string to be sent to the client. */
+    /**
+      The response string to be sent to the client. The content of file
+      literals is replaced by a placeholder naming the file.
+    */
     QByteArray asString() const;
 
+    /**
+      Appends the response string, terminated by CRLF, to @p buffer.
+      Avoids the temporary copies of asString() when batching responses.
+      File literals are replaced by a placeholder like in asString().
+    */
+    void appendTo( QByteArray &buffer ) const;
+
+    /**
+      A literal whose content is read from a file only when the response
+      is written to the client.
+    */
+    struct FileLiteral {
+        /** Offset in the output buffer where the file content belongs. */
+        int position;
+        QString fileName;
+        qint64 size;
+    };
+
+    /**
+      Appends the response string like appendTo( QByteArray& ), but leaves out
+      the content of file literals. Their positions in @p buffer are appended
+      to @p fileLiterals instead.
+    */
+    void appendTo( QByteArray &buffer, QVector<FileLiteral> &fileLiterals ) const;
+
+    /** Returns @c true if this is an untagged ('*') response. */
+    bool isUntagged() const;
+
+    /** Returns @c true if the response contains literals added by appendFileLiteral(). */
+    bool hasFileLiterals() const;
+
     void setTag( const QByteArray &tag );
     void setUntagged();
     void setContinuation();
 
+    /**
+      Marks the response as incomplete. It is sent without the terminating
+      CRLF and completed by the following responses marked with setContinued().
+      This allows to send large responses in pieces.
+    */
+    void setPartial( bool partial );
+
+    /**
+      Marks the response as continuation of a partial response. It is sent
+      without tag and result code.
+    */
+    void setContinued( bool continued );
+
     void setString( const char *string );
     void setString( const QByteArray &string );
 
+    /** Appends @p string to the response string. */
+    void appendString( const QByteArray &string );
+
+    /**
+      Appends a literal of @p size bytes to the response string. The content is
+      streamed from @p fileName when the response is sent, so it never has to be
+      held in memory.
+    */
+    void appendFileLiteral( const QString &fileName, qint64 size );
+
     void setSuccess();
     void setFailure();
     void setError();
     void setBye();
     void setUserDefined();
 private:
+    void appendPrefixTo( QByteArray &buffer ) const;
+    void appendResponseString( QByteArray &buffer ) const;
+
     QByteArray m_responseString;
     ResultCode m_resultCode;
     QByteArray m_tag;
+    bool m_partial;
+    bool m_continued;
+    // positions are relative to m_responseString
+    QVector<FileLiteral> m_fileLiterals;
 };
 
 } // namespace Server
@@ -19,6 +19,8 @@
 
 #include "searchtaskmanager.h"
 #include "agentsearchinstance.h"
+#include "agentmetadatacache.h"
+#include "akonadi.h"
 #include "akdebug.h"
 #include "akdbus.h"
 #include "connection.h"
@@ -124,15 +126,24 @@ void SearchTaskManager::addTask( SearchTask *task )
 
   mInstancesLock.lock();
 
+  AgentMetadataCache *cache = AkonadiServer::instance()->agentMetadataCache();
   org::freedesktop::Akonadi::AgentManager agentManager( AkDBus::serviceName( AkDBus::Control ), QLatin1String( "/AgentManager" ),
                                                         DBusConnectionPool::threadConnection() );
   do {
     const QString resourceId = query.value( 1 ).toString();
     if ( !mInstances.contains( resourceId ) ) {
       akDebug() << "Resource" << resourceId << "does not implement Search interface, skipping";
-    } else if ( !agentManager.agentInstanceOnline( resourceId ) ) {
+      continue;
+    }
+
+    AgentMetadataCache::AgentInfo info;
+    if ( !cache || !cache->agentInfo( resourceId, info ) ) {
+      info.online = agentManager.agentInstanceOnline( resourceId );
+      info.status = agentManager.agentInstanceStatus( resourceId );
+    }
+    if ( !info.online ) {
       akDebug() << "Agent" << resourceId << "is offline, skipping";
-    } else if ( agentManager.agentInstanceStatus( resourceId ) > 2 ) { // 2 == Broken, 3 == Not Configured
+    } else if ( info.status > 2 ) { // 2 == Broken, 3 == Not Configured
       akDebug() << "Agent" << resourceId << "is broken or not configured";
     } else {
       const qint64 collectionId = query.value( 0 ).toLongLong();
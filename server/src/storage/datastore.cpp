@@ -79,6 +79,7 @@ QThreadStorage<DataStore*> DataStore::sInstances;
 DataStore::DataStore()
   : QObject()
   , m_dbOpened( false )
+  , m_dbReleased( false )
   , m_transactionLevel( 0 )
   , mNotificationCollector( 0 )
   , m_keepAliveTimer( 0 )
@@ -152,6 +153,17 @@ void DataStore::close()
   m_dbOpened = false;
 }
 
+bool DataStore::releaseConnection()
+{
+  if ( !m_dbOpened || inTransaction() ) {
+    return false;
+  }
+
+  close();
+  m_dbReleased = true;
+  return true;
+}
+
 bool DataStore::init()
 {
   Q_ASSERT( QThread::currentThread() == QCoreApplication::instance()->thread() );
@@ -203,7 +215,20 @@ DataStore *DataStore::self()
   if ( !sInstances.hasLocalData() ) {
     sInstances.setLocalData( new DataStore() );
   }
-  return sInstances.localData();
+  DataStore *store = sInstances.localData();
+  if ( store->m_dbReleased ) {
+    store->m_dbReleased = false;
+    store->open();
+    if ( store->m_keepAliveTimer ) {
+      store->m_keepAliveTimer->start();
+    }
+  }
+  return store;
+}
+
+bool DataStore::hasDataStore()
+{
+  return sInstances.hasLocalData();
 }
 
 /* --- ItemFlags ----------------------------------------------------- */
@@ -250,6 +275,7 @@ bool DataStore::setItemsFlags( const PimItem::List &items, const QVector<Flag> &
 
   if ( !addedFlags.empty() ) {
     QueryBuilder qb2( PimItemFlagRelation::tableName(), QueryBuilder::Insert );
+    qb2.setBulkInsert( true );
     qb2.setColumnValue( PimItemFlagRelation::leftColumn(), insIds );
     qb2.setColumnValue( PimItemFlagRelation::rightColumn(), insFlags );
     qb2.setIdentificationColumn( QString() );
@@ -289,6 +315,7 @@ bool DataStore::doAppendItemsFlag( const PimItem::List &items, const Flag &flag,
   }
 
   QueryBuilder qb2( PimItemFlagRelation::tableName(), QueryBuilder::Insert );
+  qb2.setBulkInsert( true );
   qb2.setColumnValue( PimItemFlagRelation::leftColumn(), appendIds );
   qb2.setColumnValue( PimItemFlagRelation::rightColumn(), flagIds );
   qb2.setIdentificationColumn( QString() );
@@ -318,6 +345,37 @@ bool DataStore::appendItemsFlags( const PimItem::List &items, const QVector<Flag
 
   setBoolPtr( flagsChanged, false );
 
+  if ( !checkIfExists ) {
+    // no need to look at the flags one by one, insert all of them at once
+    QVariantList insIds;
+    QVariantList insFlags;
+    Q_FOREACH ( const Flag &flag, flags ) {
+      added << flag.name().toLatin1();
+      Q_FOREACH ( const PimItem &item, items ) {
+        insIds << item.id();
+        insFlags << flag.id();
+      }
+    }
+    if ( insIds.isEmpty() ) {
+      return true;
+    }
+
+    QueryBuilder qb( PimItemFlagRelation::tableName(), QueryBuilder::Insert );
+    qb.setBulkInsert( true );
+    qb.setColumnValue( PimItemFlagRelation::leftColumn(), insIds );
+    qb.setColumnValue( PimItemFlagRelation::rightColumn(), insFlags );
+    qb.setIdentificationColumn( QString() );
+    if ( !qb.exec() ) {
+      akDebug() << "Failed to execute query:" << qb.query().lastError();
+      return false;
+    }
+
+    if ( !silent ) {
+      mNotificationCollector->itemsFlagsChanged( items, added, QSet<QByteArray>(), col );
+    }
+    return true;
+  }
+
   Q_FOREACH ( const Flag &flag, flags ) {
     QSet<PimItem::Id> existing;
     if ( checkIfExists ) {
@@ -447,6 +505,7 @@ bool DataStore::setItemsTags( const PimItem::List &items, const Tag::List &tags,
 
   if ( !addedTags.empty() ) {
     QueryBuilder qb2( PimItemTagRelation::tableName(), QueryBuilder::Insert );
+    qb2.setBulkInsert( true );
     qb2.setColumnValue( PimItemTagRelation::leftColumn(), insIds );
     qb2.setColumnValue( PimItemTagRelation::rightColumn(), insTags );
     qb2.setIdentificationColumn( QString() );
@@ -486,6 +545,7 @@ bool DataStore::doAppendItemsTag( const PimItem::List &items, const Tag &tag,
   }
 
   QueryBuilder qb2( PimItemTagRelation::tableName(), QueryBuilder::Insert );
+  qb2.setBulkInsert( true );
   qb2.setColumnValue( PimItemTagRelation::leftColumn(), appendIds );
   qb2.setColumnValue( PimItemTagRelation::rightColumn(), tagIds );
   qb2.setIdentificationColumn( QString() );
@@ -515,6 +575,38 @@ bool DataStore::appendItemsTags( const PimItem::List &items, const Tag::List &ta
 
   setBoolPtr( tagsChanged, false );
 
+  if ( !checkIfExists ) {
+    // no need to look at the tags one by one, insert all of them at once
+    QSet<qint64> addedTags;
+    QVariantList insIds;
+    QVariantList insTags;
+    Q_FOREACH ( const Tag &tag, tags ) {
+      addedTags << tag.id();
+      Q_FOREACH ( const PimItem &item, items ) {
+        insIds << item.id();
+        insTags << tag.id();
+      }
+    }
+    if ( insIds.isEmpty() ) {
+      return true;
+    }
+
+    QueryBuilder qb( PimItemTagRelation::tableName(), QueryBuilder::Insert );
+    qb.setBulkInsert( true );
+    qb.setColumnValue( PimItemTagRelation::leftColumn(), insIds );
+    qb.setColumnValue( PimItemTagRelation::rightColumn(), insTags );
+    qb.setIdentificationColumn( QString() );
+    if ( !qb.exec() ) {
+      akDebug() << "Failed to execute query:" << qb.query().lastError();
+      return false;
+    }
+
+    if ( !silent ) {
+      mNotificationCollector->itemsTagsChanged( items, addedTags, QSet<qint64>(), col );
+    }
+    return true;
+  }
+
   Q_FOREACH ( const Tag &tag, tags ) {
     QSet<PimItem::Id> existing;
     if ( checkIfExists ) {
@@ -859,6 +951,7 @@ void DataStore::activeCachePolicy( Collection &col )
       col.setCachePolicyCacheTimeout( parent.cachePolicyCacheTimeout() );
       col.setCachePolicySyncOnDemand( parent.cachePolicySyncOnDemand() );
       col.setCachePolicyLocalParts( parent.cachePolicyLocalParts() );
+      col.setCachePolicyPrefetch( parent.cachePolicyPrefetch() );
       return;
     }
   }
@@ -868,6 +961,7 @@ void DataStore::activeCachePolicy( Collection &col )
   col.setCachePolicyCacheTimeout( -1 );
   col.setCachePolicySyncOnDemand( false );
   col.setCachePolicyLocalParts( QLatin1String( "ALL" ) );
+  col.setCachePolicyPrefetch( 0 );
 }
 
 QVector<Collection> DataStore::virtualCollections( const PimItem &item )
@@ -990,11 +1084,11 @@ bool DataStore::appendPimItem( QVector<Part> &parts,
       if ( ( *it ).datasize() < ( *it ).data().size() ) {
         ( *it ).setDatasize( ( *it ).data().size() );
       }
+    }
 
-//      akDebug() << "Insert from DataStore::appendPimItem";
-      if ( !PartHelper::insert( &( *it ) ) ) {
-        return false;
-      }
+//    akDebug() << "Insert from DataStore::appendPimItem";
+    if ( !PartHelper::insert( parts ) ) {
+      return false;
     }
   }
 
@@ -108,6 +108,14 @@ class DataStore : public QObject
     */
     virtual void close();
 
+    /**
+      Closes the database connection of an idle DataStore. The connection is
+      opened again the next time self() is called from this thread.
+      Does nothing while a transaction is in progress.
+      @returns @c true if the connection has been released
+    */
+    virtual bool releaseConnection();
+
     /**
       Initializes the database. Should be called during startup by the main thread.
     */
@@ -118,6 +126,12 @@ class DataStore : public QObject
     */
     static DataStore *self();
 
+    /**
+      Returns whether the current thread has a DataStore already,
+      without creating one.
+    */
+    static bool hasDataStore();
+
     /* --- ItemFlags ----------------------------------------------------- */
     virtual bool setItemsFlags( const PimItem::List &items, const QVector<Flag> &flags,
                                 bool *flagsChanged = 0, const Collection &col = Collection(), bool silent = false );
@@ -332,6 +346,7 @@ protected:
     QString m_connectionName;
     QSqlDatabase m_database;
     bool m_dbOpened;
+    bool m_dbReleased;
     uint m_transactionLevel;
     QVector<QPair<QSqlQuery,bool /* isBatch */> > m_transactionQueries;
     QByteArray mSessionId;
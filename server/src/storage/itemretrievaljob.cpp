@@ -22,87 +22,208 @@
 #include "itemretrievalrequest.h"
 
 #include <qdbusabstractinterface.h>
+#include <qdbusconnection.h>
+#include <qdbusmessage.h>
 #include <qdebug.h>
 
 using namespace Akonadi::Server;
 
+// Additional time in milliseconds a resource gets for each further item of a batch
+#define BATCH_RETRIEVAL_ITEM_TIMEOUT ( 10 * 1000 )
+// Timeout in milliseconds of D-Bus calls if the interface does not set one
+#define DBUS_DEFAULT_TIMEOUT ( 25 * 1000 )
+
 ItemRetrievalJob::~ItemRetrievalJob()
 {
   Q_ASSERT( !m_active );
 }
 
+bool ItemRetrievalJob::batchRetrievalSupported() const
+{
+  return m_batchSupported;
+}
+
+ItemRetrievalRequest::Priority ItemRetrievalJob::priority() const
+{
+  return m_priority;
+}
+
 void ItemRetrievalJob::start( QDBusAbstractInterface *interface )
 {
-  Q_ASSERT( m_request );
-  akDebug() << "processing retrieval request for item" << m_request->id << " parts:" << m_request->parts << " of resource:" << m_request->resourceId;
+  Q_ASSERT( !m_requests.isEmpty() );
 
   m_interface = interface;
   // call the resource
   if ( interface ) {
     m_active = true;
     m_oldMethodCalled = false;
-    QList<QVariant> arguments;
-    arguments << m_request->id
-              << QString::fromUtf8( m_request->remoteId )
-              << QString::fromUtf8( m_request->mimeType )
-              << m_request->parts;
-    interface->callWithCallback( QLatin1String( "requestItemDeliveryV2" ), arguments, this, SLOT(callFinished(QString)), SLOT(callFailed(QDBusError)) );
+    if ( m_batchSupported && m_requests.size() > 1 ) {
+      const ItemRetrievalRequest *first = m_requests.first();
+      akDebug() << "processing retrieval request for" << m_requests.size() << "items, parts:" << first->parts << " of resource:" << first->resourceId;
+      QList<qlonglong> ids;
+      QStringList remoteIds;
+      QStringList mimeTypes;
+      Q_FOREACH ( ItemRetrievalRequest *request, m_requests ) {
+        request->retrievalTimer.start();
+        ids << request->id;
+        remoteIds << QString::fromUtf8( request->remoteId );
+        mimeTypes << QString::fromUtf8( request->mimeType );
+      }
+      QList<QVariant> arguments;
+      arguments << QVariant::fromValue( ids ) << remoteIds << mimeTypes << first->parts;
+      m_batchCalled = true;
+      // the items are delivered one after another, a single call timeout
+      // shared by all of them would fail large batches of slow resources
+      int timeout = DBUS_DEFAULT_TIMEOUT;
+#if QT_VERSION >= 0x040800
+      if ( interface->timeout() > 0 ) {
+        timeout = interface->timeout();
+      }
+#endif
+      QDBusMessage message = QDBusMessage::createMethodCall( interface->service(), interface->path(), interface->interface(),
+                                                             QLatin1String( "requestItemsDelivery" ) );
+      message.setArguments( arguments );
+      interface->connection().callWithCallback( message, this, SLOT(batchCallFinished(QStringList)), SLOT(callFailed(QDBusError)),
+                                                timeout + batchExtraTimeout() );
+    } else {
+      requestNext();
+    }
   } else {
-    Q_EMIT requestCompleted( m_request, QString::fromLatin1( "Unable to contact resource" ) );
+    completeRemaining( QString::fromLatin1( "Unable to contact resource" ) );
+    Q_EMIT finished( this );
     deleteLater();
   }
 }
 
-void ItemRetrievalJob::kill()
+void ItemRetrievalJob::requestNext()
+{
+  ItemRetrievalRequest *request = m_requests.at( m_current );
+  request->retrievalTimer.start();
+  akDebug() << "processing retrieval request for item" << request->id << " parts:" << request->parts << " of resource:" << request->resourceId;
+
+  QList<QVariant> arguments;
+  arguments << request->id
+            << QString::fromUtf8( request->remoteId )
+            << QString::fromUtf8( request->mimeType )
+            << request->parts;
+  if ( m_oldMethodCalled ) {
+    m_interface->callWithCallback( QLatin1String( "requestItemDelivery" ), arguments, this, SLOT(callFinished(bool)), SLOT(callFailed(QDBusError)) );
+  } else {
+    m_interface->callWithCallback( QLatin1String( "requestItemDeliveryV2" ), arguments, this, SLOT(callFinished(QString)), SLOT(callFailed(QDBusError)) );
+  }
+}
+
+void ItemRetrievalJob::completeCurrent( const QString &errorMsg, bool itemError )
 {
+  Q_EMIT requestCompleted( m_requests.at( m_current ), errorMsg, itemError );
+  ++m_current;
+  if ( m_current < m_requests.size() ) {
+    requestNext();
+    return;
+  }
   m_active = false;
-  Q_EMIT requestCompleted( m_request, QLatin1String( "Request cancelled" ) );
+  Q_EMIT finished( this );
+  deleteLater();
+}
+
+void ItemRetrievalJob::completeRemaining( const QString &errorMsg )
+{
+  for ( ; m_current < m_requests.size(); ++m_current ) {
+    Q_EMIT requestCompleted( m_requests.at( m_current ), errorMsg, false );
+  }
+}
+
+void ItemRetrievalJob::kill( const QString &errorMsg )
+{
+  m_active = false;
+  completeRemaining( errorMsg );
+  Q_EMIT finished( this );
+}
+
+bool ItemRetrievalJob::isExpired( qint64 timeout ) const
+{
+  return m_active && m_current < m_requests.size() && m_requests.at( m_current )->retrievalTimer.hasExpired( timeout + batchExtraTimeout() );
+}
+
+int ItemRetrievalJob::batchExtraTimeout() const
+{
+  return m_batchCalled ? ( m_requests.size() - 1 ) * BATCH_RETRIEVAL_ITEM_TIMEOUT : 0;
 }
 
 void ItemRetrievalJob::callFinished( bool returnValue )
 {
-  if ( m_active ) {
-    m_active = false;
-    if ( !returnValue ) {
-      Q_EMIT requestCompleted( m_request, QString::fromLatin1( "Resource was unable to deliver item" ) );
-    } else {
-      Q_EMIT requestCompleted( m_request, QString() );
-    }
+  if ( !m_active ) {
+    deleteLater();
+    return;
+  }
+  if ( !returnValue ) {
+    completeCurrent( QString::fromLatin1( "Resource was unable to deliver item" ), true );
+  } else {
+    completeCurrent( QString() );
   }
-  deleteLater();
 }
 
 void ItemRetrievalJob::callFinished( const QString &errorMsg )
+{
+  if ( !m_active ) {
+    deleteLater();
+    return;
+  }
+  if ( !errorMsg.isEmpty() ) {
+    completeCurrent( QString::fromLatin1( "Unable to retrieve item from resource: %1" ).arg( errorMsg ), true );
+  } else {
+    completeCurrent( QString() );
+  }
+}
+
+void ItemRetrievalJob::batchCallFinished( const QStringList &errorMsgs )
 {
   if ( m_active ) {
     m_active = false;
-    if ( !errorMsg.isEmpty() ) {
-      Q_EMIT requestCompleted( m_request, QString::fromLatin1( "Unable to retrieve item from resource: %1" ).arg( errorMsg ) );
-    } else {
-      Q_EMIT requestCompleted( m_request, QString() );
+    // one (possibly empty) error message per requested item
+    for ( ; m_current < m_requests.size(); ++m_current ) {
+      const bool hasResult = m_current < errorMsgs.size();
+      const QString errorMsg = errorMsgs.value( m_current, QLatin1String( "No result from resource" ) );
+      if ( !errorMsg.isEmpty() ) {
+        Q_EMIT requestCompleted( m_requests.at( m_current ), QString::fromLatin1( "Unable to retrieve item from resource: %1" ).arg( errorMsg ), hasResult );
+      } else {
+        Q_EMIT requestCompleted( m_requests.at( m_current ), QString(), false );
+      }
     }
+    Q_EMIT finished( this );
   }
   deleteLater();
 }
 
 void ItemRetrievalJob::callFailed( const QDBusError &error )
 {
-  if ( error.type() == QDBusError::UnknownMethod && !m_oldMethodCalled ) {
-    akDebug() << "processing retrieval request (old method) for item" << m_request->id << " parts:" << m_request->parts << " of resource:" << m_request->resourceId;
+  if ( m_active && error.type() == QDBusError::UnknownMethod ) {
     Q_ASSERT( m_interface );
-    //try the old version
-    QList<QVariant> arguments;
-    arguments << m_request->id
-              << QString::fromUtf8( m_request->remoteId )
-              << QString::fromUtf8( m_request->mimeType )
-              << m_request->parts;
-    m_oldMethodCalled = true;
-    m_interface->callWithCallback( QLatin1String( "requestItemDelivery" ), arguments, this, SLOT(callFinished(bool)), SLOT(callFailed(QDBusError)) );
+    if ( m_batchCalled ) {
+      // the resource does not support batch retrieval, ask for one item after another
+      akDebug() << "resource" << m_requests.first()->resourceId << "does not support batch retrieval";
+      m_batchCalled = false;
+      m_batchSupported = false;
+      requestNext();
+      return;
+    } else if ( !m_oldMethodCalled ) {
+      //try the old version
+      m_oldMethodCalled = true;
+      requestNext();
+      return;
+    }
+  }
+  if ( !m_active ) {
+    deleteLater();
     return;
   }
-  if ( m_active ) {
+  const QString errorMsg = QString::fromLatin1( "Unable to retrieve item from resource: %1" ).arg( error.message() );
+  if ( m_batchCalled ) {
     m_active = false;
-    Q_EMIT requestCompleted( m_request, QString::fromLatin1( "Unable to retrieve item from resource: %1" ).arg( error.message() ) );
+    completeRemaining( errorMsg );
+    Q_EMIT finished( this );
+    deleteLater();
+  } else {
+    completeCurrent( errorMsg );
   }
-  deleteLater();
 }
@@ -21,6 +21,10 @@
 #define ITEMRETRIEVALJOB_H
 
 #include <QObject>
+#include <QList>
+#include <QStringList>
+
+#include "itemretrievalrequest.h"
 
 class QDBusAbstractInterface;
 class QDBusError;
@@ -28,38 +32,82 @@ class QDBusError;
 namespace Akonadi {
 namespace Server {
 
-class ItemRetrievalRequest;
-
-/// Async D-Bus retrieval, no modification of the request (thus no need for locking)
+/**
+ * Async D-Bus retrieval, no modification of the requests (thus no need for locking)
+ *
+ * Several requests for items of the same resource and with the same parts are
+ * sent to the resource in a single requestItemsDelivery call. Resources not
+ * implementing that method are asked for one item after another instead.
+ */
 class ItemRetrievalJob : public QObject
 {
   Q_OBJECT
   public:
-    ItemRetrievalJob( ItemRetrievalRequest *req, QObject *parent )
+    ItemRetrievalJob( const QList<ItemRetrievalRequest *> &requests, bool tryBatchRetrieval, QObject *parent )
       : QObject( parent )
-      , m_request( req )
+      , m_requests( requests )
+      , m_current( 0 )
       , m_active( false )
       , m_interface( 0 )
+      , m_batchCalled( false )
+      , m_batchSupported( tryBatchRetrieval )
       , m_oldMethodCalled( false )
+      , m_priority( requests.first()->priority )
     {
     }
     ~ItemRetrievalJob();
     void start( QDBusAbstractInterface *interface );
-    void kill();
+    /// Completes all outstanding requests with @p errorMsg
+    void kill( const QString &errorMsg );
+
+    /**
+     * Returns true if the resource has been asked for the request currently
+     * being processed longer than @p timeout milliseconds ago. While a batch is being retrieved,
+     * the timeout is extended by 10 seconds for each item after the first one.
+     */
+    bool isExpired( qint64 timeout ) const;
+
+    /**
+     * Returns false if the resource turned out not to support batch retrieval.
+     */
+    bool batchRetrievalSupported() const;
+
+    /**
+     * Returns the priority of the job's requests.
+     */
+    ItemRetrievalRequest::Priority priority() const;
 
   Q_SIGNALS:
-    void requestCompleted( ItemRetrievalRequest *req, const QString &errorMsg );
+    /**
+     * Emitted for each request of the job. @p itemError is true if the resource
+     * reported that it cannot deliver the item, rather than the request failing
+     * on the way, e.g. because the resource did not answer.
+     */
+    void requestCompleted( ItemRetrievalRequest *req, const QString &errorMsg, bool itemError );
+    /// Emitted once all requests have been completed
+    void finished( ItemRetrievalJob *job );
 
   private Q_SLOTS:
     void callFinished( bool returnValue );
     void callFinished( const QString &errorMsg );
+    void batchCallFinished( const QStringList &errorMsgs );
     void callFailed( const QDBusError &error );
 
   private:
-    ItemRetrievalRequest *m_request;
+    void requestNext();
+    void completeCurrent( const QString &errorMsg, bool itemError = false );
+    void completeRemaining( const QString &errorMsg );
+    /// Time in milliseconds the pending batch call may take longer than a single item
+    int batchExtraTimeout() const;
+
+    QList<ItemRetrievalRequest *> m_requests;
+    int m_current;
     bool m_active;
     QDBusAbstractInterface *m_interface;
+    bool m_batchCalled;
+    bool m_batchSupported;
     bool m_oldMethodCalled;
+    ItemRetrievalRequest::Priority m_priority;
 };
 
 } // namespace Server
@@ -21,26 +21,43 @@
 #include "itemretrievalrequest.h"
 #include "itemretrievaljob.h"
 #include "dbusconnectionpool.h"
+#include "agentmetadatacache.h"
+#include "akonadi.h"
 
 #include "resourceinterface.h"
 
 #include <akdbus.h>
 #include <akdebug.h>
+#include <akstandarddirs.h>
 
 #include <QCoreApplication>
+#include <QEventLoop>
 #include <QReadWriteLock>
-#include <QWaitCondition>
+#include <QSettings>
+#include <QTimer>
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
 
-#include <boost/scoped_ptr.hpp>
-
 using namespace Akonadi::Server;
 
+// Maximum number of items requested from a resource at once
+#define ITEM_RETRIEVAL_BATCH_SIZE 100
+// Default time in seconds after which an unprocessed retrieval request fails
+#define ITEM_RETRIEVAL_REQUEST_TIMEOUT 300
+// Default time in seconds failed retrievals are remembered for
+#define FAILED_RETRIEVAL_CACHE_TIMEOUT 600
+// Maximum number of failed retrievals to remember
+#define FAILED_RETRIEVAL_CACHE_SIZE 10000
+// Maximum number of prefetched items to track for the prefetch statistics
+#define PREFETCHED_ITEMS_TRACKED 1000
+
 ItemRetrievalManager *ItemRetrievalManager::sInstance = 0;
 
 ItemRetrievalManager::ItemRetrievalManager( QObject *parent )
   : QObject( parent ),
+    mRoundRobinOffset( 0 ),
+    mFailureCache( 0, 0 ),
+    mPrefetchCount( 0 ),
     mDBusConnection( DBusConnectionPool::threadConnection() )
 {
   // make sure we are created from the retrieval thread and only once
@@ -48,8 +65,18 @@ ItemRetrievalManager::ItemRetrievalManager( QObject *parent )
   Q_ASSERT( sInstance == 0 );
   sInstance = this;
 
+  const QSettings settings( AkStandardDirs::serverConfigFile(), QSettings::IniFormat );
+  mMaxConcurrentJobs = qMax( 1, settings.value( QLatin1String( "ItemRetrieval/MaxConcurrentJobsPerResource" ), 1 ).toInt() );
+  mRequestTimeout = qMax( 1, settings.value( QLatin1String( "ItemRetrieval/RequestTimeout" ), ITEM_RETRIEVAL_REQUEST_TIMEOUT ).toInt() ) * 1000LL;
+
+  const int failureCacheTimeout = settings.value( QLatin1String( "ItemRetrieval/FailedRetrievalCacheTimeout" ), FAILED_RETRIEVAL_CACHE_TIMEOUT ).toInt();
+  mFailureCache = RetrievalFailureCache( qMax( 0, failureCacheTimeout ) * 1000LL, FAILED_RETRIEVAL_CACHE_SIZE );
+
   mLock = new QReadWriteLock();
-  mWaitCondition = new QWaitCondition();
+
+  mDeadlineTimer = new QTimer( this );
+  mDeadlineTimer->setInterval( qMin<qint64>( 1000, mRequestTimeout ) );
+  connect( mDeadlineTimer, SIGNAL(timeout()), SLOT(checkDeadlines()) );
 
   connect( mDBusConnection.interface(), SIGNAL(serviceOwnerChanged(QString,QString,QString)),
            this, SLOT(serviceOwnerChanged(QString,QString,QString)) );
@@ -58,13 +85,11 @@ ItemRetrievalManager::ItemRetrievalManager( QObject *parent )
 
 ItemRetrievalManager::~ItemRetrievalManager()
 {
-  delete mWaitCondition;
   delete mLock;
 }
 
 ItemRetrievalManager *ItemRetrievalManager::instance()
 {
-  Q_ASSERT( sInstance );
   return sInstance;
 }
 
@@ -82,6 +107,8 @@ void ItemRetrievalManager::serviceOwnerChanged( const QString &serviceName, cons
   }
   akDebug() << "Lost connection to resource" << serviceName << ", discarding cached interface";
   mResourceInterfaces.remove( resourceId );
+  // the resource might have been updated
+  mNoBatchRetrieval.remove( resourceId );
 }
 
 // called within the retrieval thread
@@ -129,38 +156,224 @@ void ItemRetrievalManager::requestItemDelivery( qint64 uid, const QByteArray &re
 
 void ItemRetrievalManager::requestItemDelivery( ItemRetrievalRequest *req )
 {
+  requestItemsDelivery( QList<ItemRetrievalRequest *>() << req );
+}
+
+void ItemRetrievalManager::requestItemsDelivery( const QList<ItemRetrievalRequest *> &requests )
+{
+  if ( requests.isEmpty() ) {
+    return;
+  }
+
+  // connected before posting, so no notification can get lost
+  QEventLoop loop;
+  connect( this, SIGNAL(requestsFinished()), &loop, SLOT(quit()), Qt::QueuedConnection );
+
   mLock->lockForWrite();
-  akDebug() << "posting retrieval request for item" << req->id << " there are "
-            << mPendingRequests.size() << " queues and "
-            << mPendingRequests[req->resourceId].size() << " items in mine";
-  mPendingRequests[req->resourceId].append( req );
+  Q_FOREACH ( ItemRetrievalRequest *req, requests ) {
+    QString errorMsg;
+    if ( mFailureCache.lookup( req->id, req->revision, req->parts, errorMsg ) ) {
+      akDebug() << "retrieval of item" << req->id << "failed recently, not asking the resource again";
+      req->errorMsg = errorMsg;
+      req->processed = true;
+      continue;
+    }
+    akDebug() << "posting retrieval request for item" << req->id << " there are "
+              << mPendingRequests.size() << " queues and "
+              << mPendingRequests[req->resourceId].size() << " items in mine";
+    req->queueTimer.start();
+    mPendingRequests[req->resourceId].requests[req->priority].append( req );
+  }
   mLock->unlock();
 
   Q_EMIT requestAdded();
 
-  mLock->lockForRead();
+  // Wait in a local event loop instead of blocking the thread, so the
+  // connection keeps flushing its output while the resources are busy
   Q_FOREVER {
-    //akDebug() << "checking if request for item" << req->id << "has been processed...";
-    if ( req->processed ) {
-      boost::scoped_ptr<ItemRetrievalRequest> reqDeleter( req );
-      Q_ASSERT( !mPendingRequests[req->resourceId].contains( req ) );
-      const QString errorMsg = req->errorMsg;
-      mLock->unlock();
+    bool allProcessed = true;
+    mLock->lockForRead();
+    Q_FOREACH ( const ItemRetrievalRequest *req, requests ) {
+      if ( !req->processed ) {
+        allProcessed = false;
+        break;
+      }
+    }
+    mLock->unlock();
+    if ( allProcessed ) {
+      break;
+    }
+    akDebug() << "retrieval requests still pending - waiting";
+    // returns -1 once the thread has been asked to quit, e.g. because the client disconnected
+    if ( loop.exec() < 0 ) {
+      abandonRequests( requests );
+      throw ItemRetrieverException( "Connection closed while waiting for item retrieval" );
+    }
+  }
+
+  QString errorMsg;
+  mLock->lockForRead();
+  Q_FOREACH ( ItemRetrievalRequest *req, requests ) {
+    Q_ASSERT( !mPendingRequests.value( req->resourceId ).requests[req->priority].contains( req ) );
+    if ( req->errorMsg.isEmpty() ) {
+      akDebug() << "request for item" << req->id << "succeeded";
+    } else {
+      akDebug() << "request for item" << req->id << req->remoteId << "failed:" << req->errorMsg;
       if ( errorMsg.isEmpty() ) {
-        akDebug() << "request for item" << req->id << "succeeded";
-        return;
-      } else {
-        akDebug() << "request for item" << req->id << req->remoteId << "failed:" << errorMsg;
-        throw ItemRetrieverException( errorMsg );
+        errorMsg = req->errorMsg;
       }
+    }
+  }
+  mLock->unlock();
+  qDeleteAll( requests );
+
+  if ( !errorMsg.isEmpty() ) {
+    throw ItemRetrieverException( errorMsg );
+  }
+}
+
+void ItemRetrievalManager::prefetchItems( const QList<ItemRetrievalRequest *> &requests )
+{
+  if ( requests.isEmpty() ) {
+    return;
+  }
+
+  mLock->lockForWrite();
+  Q_FOREACH ( ItemRetrievalRequest *req, requests ) {
+    QString errorMsg;
+    if ( mFailureCache.lookup( req->id, req->revision, req->parts, errorMsg ) ) {
+      delete req;
+      continue;
+    }
+    req->priority = ItemRetrievalRequest::BackgroundPriority;
+    req->abandoned = true;
+    req->queueTimer.start();
+    mPendingRequests[req->resourceId].requests[req->priority].append( req );
+
+    mPrefetchedItems.insert( req->id, ++mPrefetchCount );
+    mPrefetchOrder.enqueue( qMakePair( req->id, mPrefetchCount ) );
+    // stop tracking the oldest prefetches, unless prefetched again since
+    while ( mPrefetchOrder.size() > PREFETCHED_ITEMS_TRACKED ) {
+      const QPair<qint64, qint64> oldest = mPrefetchOrder.dequeue();
+      QHash<qint64, qint64>::Iterator it = mPrefetchedItems.find( oldest.first );
+      if ( it != mPrefetchedItems.end() && it.value() == oldest.second ) {
+        mPrefetchedItems.erase( it );
+      }
+    }
+    ++mPrefetchStatistics.requests;
+  }
+  mLock->unlock();
+
+  Q_EMIT requestAdded();
+}
+
+void ItemRetrievalManager::itemOpened( qint64 id, bool cached )
+{
+  mLock->lockForWrite();
+  if ( mPrefetchedItems.remove( id ) ) {
+    if ( cached ) {
+      ++mPrefetchStatistics.hits;
+    } else {
+      ++mPrefetchStatistics.late;
+    }
+  } else if ( !cached ) {
+    ++mPrefetchStatistics.misses;
+  }
+  mLock->unlock();
+}
+
+void ItemRetrievalManager::invalidateFailedRetrievals( const QVector<qint64> &ids )
+{
+  mLock->lockForWrite();
+  Q_FOREACH ( qint64 id, ids ) {
+    mFailureCache.invalidate( id );
+  }
+  mLock->unlock();
+}
+
+// called from the requesting thread
+void ItemRetrievalManager::abandonRequests( const QList<ItemRetrievalRequest *> &requests )
+{
+  mLock->lockForWrite();
+  Q_FOREACH ( ItemRetrievalRequest *req, requests ) {
+    if ( !req->processed && !( mPendingRequests.contains( req->resourceId )
+                               && mPendingRequests[req->resourceId].requests[req->priority].removeOne( req ) ) ) {
+      // owned by a running job, deleted in retrievalJobFinished()
+      req->abandoned = true;
     } else {
-      akDebug() << "request for item" << req->id << "still pending - waiting";
-      mWaitCondition->wait( mLock );
-      akDebug() << "continuing";
+      delete req;
     }
   }
+  mLock->unlock();
+}
+
+// called within the retrieval thread
+int ItemRetrievalManager::maxConcurrentJobs( const QString &resourceId ) const
+{
+  AgentMetadataCache::AgentInfo info;
+  AgentMetadataCache *cache = AkonadiServer::instance()->agentMetadataCache();
+  if ( cache && cache->agentInfo( resourceId, info ) && info.maxConcurrentRetrievals > 0 ) {
+    return info.maxConcurrentRetrievals;
+  }
+  return mMaxConcurrentJobs;
+}
+
+bool ItemRetrievalManager::RequestQueue::isEmpty() const
+{
+  for ( int i = 0; i < ItemRetrievalRequest::PriorityCount; ++i ) {
+    if ( !requests[i].isEmpty() ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int ItemRetrievalManager::RequestQueue::size() const
+{
+  int size = 0;
+  for ( int i = 0; i < ItemRetrievalRequest::PriorityCount; ++i ) {
+    size += requests[i].size();
+  }
+  return size;
+}
+
+// called within the retrieval thread, with mLock locked for writing
+ItemRetrievalJob *ItemRetrievalManager::createJob( const QString &resourceId, ItemRetrievalRequest::Priority priority )
+{
+  QList<ItemRetrievalRequest *> &queue = mPendingRequests[resourceId].requests[priority];
+
+  // TODO: check if there is another one for the same uid with more parts requested
+  ItemRetrievalRequest *req = queue.takeFirst();
+  Q_ASSERT( req->resourceId == resourceId );
+  QList<ItemRetrievalRequest *> batch;
+  batch << req;
+  const bool tryBatchRetrieval = !mNoBatchRetrieval.contains( resourceId );
+  if ( tryBatchRetrieval ) {
+    // send all pending requests of the same priority for the same parts along
+    for ( QList<ItemRetrievalRequest *>::Iterator reqIt = queue.begin();
+          reqIt != queue.end() && batch.size() < ITEM_RETRIEVAL_BATCH_SIZE; ) {
+      if ( ( *reqIt )->parts == req->parts ) {
+        batch << *reqIt;
+        reqIt = queue.erase( reqIt );
+      } else {
+        ++reqIt;
+      }
+    }
+  }
+
+  WaitStatistics &statistics = mWaitStatistics[priority];
+  Q_FOREACH ( const ItemRetrievalRequest *request, batch ) {
+    const qint64 waitTime = request->queueTimer.elapsed();
+    ++statistics.count;
+    statistics.total += waitTime;
+    statistics.maximum = qMax( statistics.maximum, waitTime );
+  }
 
-  throw ItemRetrieverException( "WTF?" );
+  ItemRetrievalJob *job = new ItemRetrievalJob( batch, tryBatchRetrieval, this );
+  connect( job, SIGNAL(requestCompleted(ItemRetrievalRequest*,QString,bool)), SLOT(retrievalJobFinished(ItemRetrievalRequest*,QString,bool)) );
+  connect( job, SIGNAL(finished(ItemRetrievalJob*)), SLOT(retrievalJobDone(ItemRetrievalJob*)) );
+  mCurrentJobs[resourceId].append( job );
+  return job;
 }
 
 // called within the retrieval thread
@@ -169,61 +382,264 @@ void ItemRetrievalManager::processRequest()
   QVector<QPair<ItemRetrievalJob*, QString> > newJobs;
 
   mLock->lockForWrite();
-  // look for idle resources
-  for ( QHash< QString, QList< ItemRetrievalRequest *> >::iterator it = mPendingRequests.begin(); it != mPendingRequests.end(); ) {
+  // Start jobs for resources with free job slots, one per resource per round,
+  // and start each call with a different resource, so that a resource with
+  // a long queue can't starve the others
+  const QStringList resources = mPendingRequests.keys();
+  bool jobStarted = !resources.isEmpty();
+  while ( jobStarted ) {
+    jobStarted = false;
+    for ( int i = 0; i < resources.size(); ++i ) {
+      const QString &resourceId = resources.at( ( i + mRoundRobinOffset ) % resources.size() );
+      const RequestQueue &queue = mPendingRequests[resourceId];
+      const QList<ItemRetrievalJob *> &jobs = mCurrentJobs[resourceId];
+      const int maxJobs = maxConcurrentJobs( resourceId );
+
+      // Interactive requests are always started first and have job slots of
+      // their own, so they never wait for background retrievals to finish.
+      // Running jobs are not interrupted though.
+      int interactiveJobs = 0;
+      Q_FOREACH ( const ItemRetrievalJob *job, jobs ) {
+        if ( job->priority() == ItemRetrievalRequest::InteractivePriority ) {
+          ++interactiveJobs;
+        }
+      }
+      ItemRetrievalJob *job = 0;
+      if ( !queue.requests[ItemRetrievalRequest::InteractivePriority].isEmpty() && interactiveJobs < maxJobs ) {
+        job = createJob( resourceId, ItemRetrievalRequest::InteractivePriority );
+      } else if ( !queue.requests[ItemRetrievalRequest::BackgroundPriority].isEmpty() && jobs.size() < maxJobs ) {
+        job = createJob( resourceId, ItemRetrievalRequest::BackgroundPriority );
+      } else {
+        continue;
+      }
+
+      // delay job execution until after we unlocked the mutex, since the job can emit the finished signal immediately in some cases
+      newJobs.append( qMakePair( job, resourceId ) );
+      jobStarted = true;
+    }
+  }
+  mRoundRobinOffset = resources.isEmpty() ? 0 : ( mRoundRobinOffset + 1 ) % resources.size();
+
+  for ( QHash<QString, RequestQueue>::iterator it = mPendingRequests.begin(); it != mPendingRequests.end(); ) {
     if ( it.value().isEmpty() ) {
       it = mPendingRequests.erase( it );
-      continue;
+    } else {
+      ++it;
     }
-    if ( !mCurrentJobs.contains( it.key() ) || mCurrentJobs.value( it.key() ) == 0 ) {
-      // TODO: check if there is another one for the same uid with more parts requested
-      ItemRetrievalRequest *req = it.value().takeFirst();
-      Q_ASSERT( req->resourceId == it.key() );
-      ItemRetrievalJob *job = new ItemRetrievalJob( req, this );
-      connect( job, SIGNAL(requestCompleted(ItemRetrievalRequest*,QString)), SLOT(retrievalJobFinished(ItemRetrievalRequest*,QString)) );
-      mCurrentJobs.insert( req->resourceId, job );
-      // delay job execution until after we unlocked the mutex, since the job can emit the finished signal immediately in some cases
-      newJobs.append( qMakePair( job, req->resourceId ) );
+  }
+  for ( QHash<QString, QList<ItemRetrievalJob *> >::iterator it = mCurrentJobs.begin(); it != mCurrentJobs.end(); ) {
+    if ( it.value().isEmpty() ) {
+      it = mCurrentJobs.erase( it );
+    } else {
+      ++it;
     }
-    ++it;
   }
 
   bool nothingGoingOn = mPendingRequests.isEmpty() && mCurrentJobs.isEmpty() && newJobs.isEmpty();
   mLock->unlock();
 
-  if ( nothingGoingOn ) { // someone asked as to process requests although everything is done already, he might still be waiting
-    mWaitCondition->wakeAll();
+  if ( nothingGoingOn ) {
+    mDeadlineTimer->stop();
     return;
   }
+  if ( !mDeadlineTimer->isActive() ) {
+    mDeadlineTimer->start();
+  }
 
   for ( QVector<QPair<ItemRetrievalJob *, QString> >::const_iterator it = newJobs.constBegin(); it != newJobs.constEnd(); ++it ) {
     ( *it ).first->start( resourceInterface( ( *it ).second ) );
   }
 }
 
-void ItemRetrievalManager::retrievalJobFinished( ItemRetrievalRequest *request, const QString &errorMsg )
+// called from any thread
+QVariantMap ItemRetrievalManager::queueStatistics() const
+{
+  QVariantMap statistics;
+  mLock->lockForRead();
+  QSet<QString> resources = mPendingRequests.keys().toSet();
+  resources.unite( mCurrentJobs.keys().toSet() );
+  Q_FOREACH ( const QString &resourceId, resources ) {
+    const RequestQueue queue = mPendingRequests.value( resourceId );
+    QVariantMap resourceStatistics;
+    resourceStatistics.insert( QLatin1String( "pendingInteractiveRequests" ), queue.requests[ItemRetrievalRequest::InteractivePriority].size() );
+    resourceStatistics.insert( QLatin1String( "pendingBackgroundRequests" ), queue.requests[ItemRetrievalRequest::BackgroundPriority].size() );
+    resourceStatistics.insert( QLatin1String( "runningJobs" ), mCurrentJobs.value( resourceId ).size() );
+    statistics.insert( resourceId, resourceStatistics );
+  }
+  mLock->unlock();
+  return statistics;
+}
+
+// called from any thread
+QVariantMap ItemRetrievalManager::waitStatistics() const
+{
+  static const char *names[ItemRetrievalRequest::PriorityCount] = { "interactive", "background" };
+
+  QVariantMap statistics;
+  mLock->lockForRead();
+  for ( int i = 0; i < ItemRetrievalRequest::PriorityCount; ++i ) {
+    const WaitStatistics &wait = mWaitStatistics[i];
+    QVariantMap classStatistics;
+    classStatistics.insert( QLatin1String( "requests" ), wait.count );
+    classStatistics.insert( QLatin1String( "averageWaitTime" ), wait.count > 0 ? wait.total / wait.count : 0 );
+    classStatistics.insert( QLatin1String( "maximumWaitTime" ), wait.maximum );
+    statistics.insert( QLatin1String( names[i] ), classStatistics );
+  }
+  mLock->unlock();
+  return statistics;
+}
+
+// called with mLock locked for writing
+void ItemRetrievalManager::completeRequest( ItemRetrievalRequest *request, const QString &errorMsg )
+{
+  if ( request->abandoned ) {
+    // nobody is waiting for it
+    delete request;
+  } else {
+    request->errorMsg = errorMsg;
+    request->processed = true;
+  }
+}
+
+void ItemRetrievalManager::retrievalJobFinished( ItemRetrievalRequest *request, const QString &errorMsg, bool itemError )
 {
   mLock->lockForWrite();
-  request->errorMsg = errorMsg;
-  request->processed = true;
-  Q_ASSERT( mCurrentJobs.contains( request->resourceId ) );
-  mCurrentJobs.remove( request->resourceId );
+  const QString resourceId = request->resourceId;
+  const qint64 id = request->id;
+  Q_ASSERT( mCurrentJobs.contains( resourceId ) );
+  if ( itemError ) {
+    mFailureCache.insert( id, request->revision, request->parts, errorMsg );
+  }
+  if ( errorMsg.isEmpty() || itemError ) {
+    mLastDelivery[resourceId].start();
+  }
+  completeRequest( request, errorMsg );
   // TODO check if (*it)->parts is a subset of currentRequest->parts
-  for ( QList<ItemRetrievalRequest *>::Iterator it = mPendingRequests[request->resourceId].begin(); it != mPendingRequests[request->resourceId].end(); ) {
-    if ( ( *it )->id == request->id ) {
-      akDebug() << "someone else requested item" << request->id << "as well, marking as processed";
-      ( *it )->errorMsg = errorMsg;
-      ( *it )->processed = true;
-      it = mPendingRequests[request->resourceId].erase( it );
-    } else {
-      ++it;
+  if ( mPendingRequests.contains( resourceId ) ) {
+    RequestQueue &queue = mPendingRequests[resourceId];
+    for ( int i = 0; i < ItemRetrievalRequest::PriorityCount; ++i ) {
+      for ( QList<ItemRetrievalRequest *>::Iterator it = queue.requests[i].begin(); it != queue.requests[i].end(); ) {
+        if ( ( *it )->id == id ) {
+          akDebug() << "someone else requested item" << id << "as well, marking as processed";
+          completeRequest( *it, errorMsg );
+          it = queue.requests[i].erase( it );
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  mLock->unlock();
+
+  Q_EMIT requestsFinished();
+}
+
+void ItemRetrievalManager::retrievalJobDone( ItemRetrievalJob *job )
+{
+  mLock->lockForWrite();
+  QString resourceId;
+  for ( QHash<QString, QList<ItemRetrievalJob *> >::Iterator it = mCurrentJobs.begin(); it != mCurrentJobs.end(); ++it ) {
+    if ( it.value().removeOne( job ) ) {
+      resourceId = it.key();
+      if ( it.value().isEmpty() ) {
+        mCurrentJobs.erase( it );
+      }
+      break;
     }
   }
-  mWaitCondition->wakeAll();
+  Q_ASSERT( !resourceId.isEmpty() );
   mLock->unlock();
+
+  if ( !job->batchRetrievalSupported() ) {
+    mNoBatchRetrieval.insert( resourceId );
+  }
   Q_EMIT requestAdded(); // trigger processRequest() again, in case there is more in the queues
 }
 
+// called from any thread
+QVariantMap ItemRetrievalManager::failureCacheStatistics() const
+{
+  QVariantMap statistics;
+  // lookups update the counters, so read them with the write lock held
+  mLock->lockForWrite();
+  statistics.insert( QLatin1String( "enabled" ), mFailureCache.isEnabled() );
+  statistics.insert( QLatin1String( "size" ), mFailureCache.size() );
+  statistics.insert( QLatin1String( "hits" ), mFailureCache.hits() );
+  statistics.insert( QLatin1String( "misses" ), mFailureCache.misses() );
+  mLock->unlock();
+  return statistics;
+}
+
+// called from any thread
+QVariantMap ItemRetrievalManager::prefetchStatistics() const
+{
+  QVariantMap statistics;
+  mLock->lockForRead();
+  statistics.insert( QLatin1String( "requests" ), mPrefetchStatistics.requests );
+  statistics.insert( QLatin1String( "hits" ), mPrefetchStatistics.hits );
+  statistics.insert( QLatin1String( "late" ), mPrefetchStatistics.late );
+  statistics.insert( QLatin1String( "misses" ), mPrefetchStatistics.misses );
+  const qint64 opened = mPrefetchStatistics.hits + mPrefetchStatistics.late + mPrefetchStatistics.misses;
+  statistics.insert( QLatin1String( "hitRate" ), opened > 0 ? double( mPrefetchStatistics.hits ) / opened : 0.0 );
+  mLock->unlock();
+  return statistics;
+}
+
+// called within the retrieval thread
+void ItemRetrievalManager::checkDeadlines()
+{
+  const QString errorMsg = QString::fromLatin1( "Item retrieval timed out after %1 seconds" ).arg( mRequestTimeout / 1000 );
+  bool requestExpired = false;
+  QList<ItemRetrievalJob *> expiredJobs;
+
+  mLock->lockForWrite();
+  QSet<QString> activeResources;
+  for ( QHash<QString, QList<ItemRetrievalJob *> >::ConstIterator it = mCurrentJobs.constBegin(); it != mCurrentJobs.constEnd(); ++it ) {
+    Q_FOREACH ( ItemRetrievalJob *job, it.value() ) {
+      if ( job->isExpired( mRequestTimeout ) ) {
+        akError() << "Resource" << it.key() << "did not deliver items in time, giving up";
+        expiredJobs << job;
+      } else {
+        activeResources.insert( it.key() );
+      }
+    }
+  }
+
+  for ( QHash<QString, RequestQueue>::Iterator queueIt = mPendingRequests.begin(); queueIt != mPendingRequests.end(); ++queueIt ) {
+    // Requests queued behind a large retrieval wait as long as the resource
+    // keeps delivering, they only fail once it stopped answering
+    const QHash<QString, QElapsedTimer>::ConstIterator lastDelivery = mLastDelivery.constFind( queueIt.key() );
+    if ( activeResources.contains( queueIt.key() )
+         || ( lastDelivery != mLastDelivery.constEnd() && !lastDelivery.value().hasExpired( mRequestTimeout ) ) ) {
+      continue;
+    }
+    for ( int i = 0; i < ItemRetrievalRequest::PriorityCount; ++i ) {
+      QList<ItemRetrievalRequest *> &requests = queueIt.value().requests[i];
+      for ( QList<ItemRetrievalRequest *>::Iterator it = requests.begin(); it != requests.end(); ) {
+        if ( ( *it )->queueTimer.hasExpired( mRequestTimeout ) ) {
+          akDebug() << "retrieval request for item" << ( *it )->id << "expired in the queue of" << queueIt.key();
+          completeRequest( *it, errorMsg );
+          it = requests.erase( it );
+          requestExpired = true;
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  mLock->unlock();
+
+  // completes the requests through retrievalJobFinished() and frees the job slot
+  Q_FOREACH ( ItemRetrievalJob *job, expiredJobs ) {
+    job->kill( errorMsg );
+  }
+
+  if ( requestExpired ) {
+    Q_EMIT requestsFinished();
+    processRequest(); // drops emptied queues
+  }
+}
+
 void ItemRetrievalManager::triggerCollectionSync( const QString &resource, qint64 colId )
 {
   OrgFreedesktopAkonadiResourceInterface *interface = resourceInterface( resource );
@@ -21,14 +21,20 @@
 #define AKONADI_ITEMRETRIEVALMANAGER_H
 
 #include "itemretriever.h"
+#include "itemretrievalrequest.h"
+#include "retrievalfailurecache.h"
 
 #include <QHash>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
 #include <QStringList>
 #include <QObject>
+#include <QVariant>
 #include <QDBusConnection>
 
 class QReadWriteLock;
-class QWaitCondition;
+class QTimer;
 class OrgFreedesktopAkonadiResourceInterface;
 
 namespace Akonadi {
@@ -36,7 +42,6 @@ namespace Server {
 
 class Collection;
 class ItemRetrievalJob;
-class ItemRetrievalRequest;
 
 /** Manages and processes item retrieval requests. */
 class ItemRetrievalManager : public QObject
@@ -55,31 +60,158 @@ class ItemRetrievalManager : public QObject
      */
     void requestItemDelivery( ItemRetrievalRequest *request );
 
+    /**
+     * Posts all @p requests at once, so that requests for the same resource can
+     * be sent to it in batches, and waits until all of them have been processed.
+     * ItemRetrievalManager takes ownership over the requests. Throws an
+     * ItemRetrieverException with the first error that occurred, if any.
+     *
+     * The calling thread keeps processing its events while waiting. Requests
+     * the resource does not deliver within the ItemRetrieval/RequestTimeout fail,
+     * as do queued requests once the resource has not delivered anything for as long.
+     */
+    void requestItemsDelivery( const QList<ItemRetrievalRequest *> &requests );
+
+    /**
+     * Queues @p requests with background priority without waiting for them,
+     * used to retrieve items that are likely to be opened next.
+     * ItemRetrievalManager takes ownership over the requests.
+     */
+    void prefetchItems( const QList<ItemRetrievalRequest *> &requests );
+
+    /**
+     * Records that the payload of the single item @p id has been requested
+     * interactively, and whether it was @p cached already, for the prefetch
+     * statistics.
+     */
+    void itemOpened( qint64 id, bool cached );
+
+    /**
+     * Forgets about failed retrievals of the given items, called when they
+     * have been modified.
+     */
+    void invalidateFailedRetrievals( const QVector<qint64> &ids );
+
+    /**
+     * Returns the instance living in the retrieval thread.
+     * Can return a nullptr if the retrieval thread is not running.
+     */
     static ItemRetrievalManager *instance();
 
+    /**
+     * Returns the number of pending requests and running jobs of every
+     * resource with outstanding retrievals.
+     */
+    QVariantMap queueStatistics() const;
+
+    /**
+     * Returns the number of started requests and their average and maximum
+     * time spent in the queue, per priority class.
+     */
+    QVariantMap waitStatistics() const;
+
+    /**
+     * Returns size, hits and misses of the cache of failed retrievals.
+     */
+    QVariantMap failureCacheStatistics() const;
+
+    /**
+     * Returns the number of prefetched items and how many of the items opened
+     * afterwards had been prefetched in time (hits), were still being
+     * prefetched (late) or had not been prefetched (misses).
+     */
+    QVariantMap prefetchStatistics() const;
+
   Q_SIGNALS:
     void requestAdded();
+    /// Emitted from the retrieval thread when requests have been processed
+    void requestsFinished();
 
   private:
     OrgFreedesktopAkonadiResourceInterface *resourceInterface( const QString &id );
+    int maxConcurrentJobs( const QString &resourceId ) const;
+    ItemRetrievalJob *createJob( const QString &resourceId, ItemRetrievalRequest::Priority priority );
+    void completeRequest( ItemRetrievalRequest *request, const QString &errorMsg );
+    void abandonRequests( const QList<ItemRetrievalRequest *> &requests );
 
   private Q_SLOTS:
     void serviceOwnerChanged( const QString &serviceName, const QString &oldOwner, const QString &newOwner );
     void processRequest();
     void triggerCollectionSync( const QString &resource, qint64 colId );
     void triggerCollectionTreeSync( const QString &resource );
-    void retrievalJobFinished( ItemRetrievalRequest *request, const QString &errorMsg );
+    void retrievalJobFinished( ItemRetrievalRequest *request, const QString &errorMsg, bool itemError );
+    void retrievalJobDone( ItemRetrievalJob *job );
+    void checkDeadlines();
 
   private:
     static ItemRetrievalManager *sInstance;
     /// Protects mPendingRequests and every Request object posted to it
     QReadWriteLock *mLock;
-    /// Used to let requesting threads wait until the request has been processed
-    QWaitCondition *mWaitCondition;
+    /// Fails requests that have not been processed in time
+    QTimer *mDeadlineTimer;
+    /// Maximum time in milliseconds a resource may take to deliver an item, and
+    /// requests may stay queued while their resource does not deliver anything
+    qint64 mRequestTimeout;
+    /// Time since each resource last answered a request
+    QHash<QString, QElapsedTimer> mLastDelivery;
+    /// Pending requests of a resource, one queue per priority class
+    struct RequestQueue
+    {
+      bool isEmpty() const;
+      int size() const;
+
+      QList<ItemRetrievalRequest *> requests[ItemRetrievalRequest::PriorityCount];
+    };
     /// Pending requests queues, one per resource
-    QHash<QString, QList<ItemRetrievalRequest *> > mPendingRequests;
-    /// Currently running jobs, one per resource
-    QHash<QString, ItemRetrievalJob *> mCurrentJobs;
+    QHash<QString, RequestQueue> mPendingRequests;
+    /// Currently running jobs per resource
+    QHash<QString, QList<ItemRetrievalJob *> > mCurrentJobs;
+    /// Default number of concurrent jobs per resource
+    int mMaxConcurrentJobs;
+    /// Resource processRequest() starts with, rotated on every call
+    int mRoundRobinOffset;
+    /// Time requests spent in the queue, per priority class
+    struct WaitStatistics
+    {
+      WaitStatistics()
+        : count( 0 )
+        , total( 0 )
+        , maximum( 0 )
+      {
+      }
+
+      qint64 count;
+      qint64 total;
+      qint64 maximum;
+    };
+    WaitStatistics mWaitStatistics[ItemRetrievalRequest::PriorityCount];
+    /// Recently failed retrievals, not passed on to the resource again
+    RetrievalFailureCache mFailureCache;
+    /// Recently prefetched items, to find out whether they are opened later,
+    /// mapped to the number of their prefetch
+    QHash<qint64, qint64> mPrefetchedItems;
+    /// Prefetched items with the number of their prefetch, oldest first
+    QQueue<QPair<qint64, qint64> > mPrefetchOrder;
+    /// Number of the last prefetch
+    qint64 mPrefetchCount;
+    struct PrefetchStatistics
+    {
+      PrefetchStatistics()
+        : requests( 0 )
+        , hits( 0 )
+        , late( 0 )
+        , misses( 0 )
+      {
+      }
+
+      qint64 requests;
+      qint64 hits;
+      qint64 late;
+      qint64 misses;
+    };
+    PrefetchStatistics mPrefetchStatistics;
+    /// Resources not supporting batch retrieval, only accessed from the retrieval thread
+    QSet<QString> mNoBatchRetrieval;
 
     // resource dbus interface cache
     QHash<QString, OrgFreedesktopAkonadiResourceInterface *> mResourceInterfaces;
@@ -21,6 +21,7 @@
 #define ITEMRETRIEVALREQUEST_H
 
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QStringList>
 
 namespace Akonadi {
@@ -30,17 +31,35 @@ namespace Server {
 class ItemRetrievalRequest
 {
   public:
+    /// Retrieval priority classes, in descending order of priority
+    enum Priority {
+      InteractivePriority, ///< items a user is waiting for
+      BackgroundPriority,  ///< bulk retrieval, e.g. by indexing agents
+      PriorityCount
+    };
+
     ItemRetrievalRequest()
-      : processed( false )
+      : revision( 0 )
+      , priority( InteractivePriority )
+      , processed( false )
+      , abandoned( false )
     {
     }
     qint64 id;
+    int revision;
     QByteArray remoteId;
     QByteArray mimeType;
     QString resourceId;
     QStringList parts;
+    Priority priority;
+    /// Measures how long the request waits in the queue
+    QElapsedTimer queueTimer;
+    /// Measures how long the resource takes to deliver the item, started when it is asked for it
+    QElapsedTimer retrievalTimer;
     QString errorMsg;
     bool processed;
+    /// The requester stopped waiting, the request is deleted once processed
+    bool abandoned;
   private:
     Q_DISABLE_COPY( ItemRetrievalRequest )
 };
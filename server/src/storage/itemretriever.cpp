@@ -21,6 +21,7 @@
 #include "itemretriever.h"
 
 #include "akdebug.h"
+#include "commandthrottle.h"
 #include "connection.h"
 #include "storage/datastore.h"
 #include "storage/itemqueryhelper.h"
@@ -44,7 +45,14 @@ ItemRetriever::ItemRetriever( Connection *connection )
   , mConnection( connection )
   , mFullPayload( false )
   , mRecursive( false )
+  , mCollectionTreeIsVirtual( false )
+  , mPriority( ItemRetrievalRequest::InteractivePriority )
 {
+  // Indexing agents fetch items nobody is waiting for, don't let them delay
+  // retrievals requested by the user
+  if ( mConnection && mConnection->sessionId().startsWith( "akonadi_baloo_indexer" ) ) {
+    mPriority = ItemRetrievalRequest::BackgroundPriority;
+  }
 }
 
 ItemRetriever::~ItemRetriever()
@@ -65,6 +73,16 @@ void ItemRetriever::setRetrieveParts( const QStringList &parts )
   }
 }
 
+void ItemRetriever::setPriority( ItemRetrievalRequest::Priority priority )
+{
+  mPriority = priority;
+}
+
+ItemRetrievalRequest::Priority ItemRetriever::priority() const
+{
+  return mPriority;
+}
+
 void ItemRetriever::setItemSet( const ImapSet &set, const Collection &collection )
 {
   mItemSet = set;
@@ -128,15 +146,74 @@ QStringList ItemRetriever::retrieveParts() const
 enum QueryColumns {
   PimItemIdColumn,
   PimItemRidColumn,
+  PimItemRevColumn,
 
   MimeTypeColumn,
 
+  CollectionIdColumn,
   ResourceColumn,
 
   PartTypeNameColumn,
   PartDatasizeColumn
 };
 
+void ItemRetriever::itemsToQuery( QueryBuilder &qb ) const
+{
+  if ( mScope.scope() != Scope::Invalid ) {
+    ItemQueryHelper::scopeToQuery( mScope, mConnection->context(), qb );
+  } else if ( !mCollectionTree.isEmpty() ) {
+    if ( mCollectionTreeIsVirtual ) {
+      qb.addJoin( QueryBuilder::InnerJoin, CollectionPimItemRelation::tableName(),
+                  CollectionPimItemRelation::rightFullColumnName(), PimItem::idFullColumnName() );
+      qb.addValueCondition( CollectionPimItemRelation::leftFullColumnName(), Query::In, mCollectionTree );
+    } else {
+      qb.addValueCondition( PimItem::collectionIdFullColumnName(), Query::In, mCollectionTree );
+    }
+  } else {
+    ItemQueryHelper::itemSetToQuery( mItemSet, qb, mCollection );
+  }
+}
+
+void ItemRetriever::collectionTree( QVariantList &collections, QVariantList &virtualCollections ) const
+{
+  if ( mCollection.isVirtual() || mCollection.resource().isVirtual() ) {
+    virtualCollections << mCollection.id();
+  } else {
+    collections << mCollection.id();
+  }
+
+  const int maxIds = QueryBuilder::maxBindValues( DbType::type( DataStore::self()->database() ) );
+  QVariantList parents;
+  parents << mCollection.id();
+  while ( !parents.isEmpty() ) {
+    QVariantList children;
+    for ( int offset = 0; offset < parents.size(); offset += maxIds ) {
+      QueryBuilder qb( Collection::tableName() );
+      qb.addJoin( QueryBuilder::InnerJoin, Resource::tableName(), Collection::resourceIdFullColumnName(), Resource::idFullColumnName() );
+      qb.addColumn( Collection::idFullColumnName() );
+      qb.addColumn( Collection::isVirtualFullColumnName() );
+      qb.addColumn( Resource::isVirtualFullColumnName() );
+      qb.addValueCondition( Collection::parentIdFullColumnName(), Query::In, parents.mid( offset, maxIds ) );
+      if ( !qb.exec() ) {
+        mLastError = "Unable to retrieve child collections";
+        throw ItemRetrieverException( mLastError );
+      }
+      QSqlQuery query = qb.query();
+      while ( query.next() ) {
+        const qint64 id = query.value( 0 ).toLongLong();
+        children << id;
+        if ( query.value( 1 ).toBool() || query.value( 2 ).toBool() ) {
+          virtualCollections << id;
+        } else {
+          collections << id;
+        }
+      }
+      query.finish();
+    }
+    parents = children;
+  }
+}
+
 QSqlQuery ItemRetriever::buildQuery() const
 {
   QueryBuilder qb( PimItem::tableName() );
@@ -159,16 +236,14 @@ QSqlQuery ItemRetriever::buildQuery() const
 
   qb.addColumn( PimItem::idFullColumnName() );
   qb.addColumn( PimItem::remoteIdFullColumnName() );
+  qb.addColumn( PimItem::revFullColumnName() );
   qb.addColumn( MimeType::nameFullColumnName() );
+  qb.addColumn( PimItem::collectionIdFullColumnName() );
   qb.addColumn( Resource::nameFullColumnName() );
   qb.addColumn( PartType::nameFullColumnName() );
   qb.addColumn( Part::datasizeFullColumnName() );
 
-  if ( mScope.scope() != Scope::Invalid ) {
-    ItemQueryHelper::scopeToQuery( mScope, mConnection->context(), qb );
-  } else {
-    ItemQueryHelper::itemSetToQuery( mItemSet, qb, mCollection );
-  }
+  itemsToQuery( qb );
 
   // prevent a resource to trigger item retrieval from itself
   if ( mConnection ) {
@@ -193,34 +268,38 @@ QSqlQuery ItemRetriever::buildQuery() const
   return qb.query();
 }
 
-bool ItemRetriever::exec()
+void ItemRetriever::collectRequests( const QStringList &parts, QList<ItemRetrievalRequest *> &requests,
+                                     QSet<qint64> &requestedIds, qint64 &lastCollectionId )
 {
-  if ( mParts.isEmpty() && !mFullPayload ) {
-    return true;
-  }
-
   verifyCache();
 
   QSqlQuery query = buildQuery();
   ItemRetrievalRequest *lastRequest = 0;
-  QList<ItemRetrievalRequest *> requests;
-
-  QStringList parts;
-  Q_FOREACH ( const QString &part, mParts ) {
-    if ( part.startsWith( QLatin1String( AKONADI_PARAM_PLD ) ) ) {
-      parts << part.mid( 4 );
-    }
-  }
+  qint64 skippedId = -1;
 
   while ( query.isValid() ) {
     const qint64 pimItemId = query.value( PimItemIdColumn ).toLongLong();
+    if ( pimItemId == skippedId ) {
+      query.next();
+      continue;
+    }
     if ( !lastRequest || lastRequest->id != pimItemId ) {
+      if ( requestedIds.contains( pimItemId ) ) {
+        // already found in another part of the collection tree
+        skippedId = pimItemId;
+        query.next();
+        continue;
+      }
+      requestedIds.insert( pimItemId );
       lastRequest = new ItemRetrievalRequest();
       lastRequest->id = pimItemId;
+      lastRequest->priority = mPriority;
       lastRequest->remoteId = Utils::variantToByteArray( query.value( PimItemRidColumn ) );
+      lastRequest->revision = query.value( PimItemRevColumn ).toInt();
       lastRequest->mimeType = Utils::variantToByteArray( query.value( MimeTypeColumn ) );
       lastRequest->resourceId = Utils::variantToString( query.value( ResourceColumn ) );
       lastRequest->parts = parts;
+      lastCollectionId = query.value( CollectionIdColumn ).toLongLong();
       requests << lastRequest;
     }
 
@@ -246,42 +325,158 @@ bool ItemRetriever::exec()
     query.next();
   }
 
-  //akDebug() << "Closing queries and sending out requests.";
-
   query.finish();
+}
+
+bool ItemRetriever::exec()
+{
+  if ( mParts.isEmpty() && !mFullPayload ) {
+    return true;
+  }
+
+  QStringList parts;
+  Q_FOREACH ( const QString &part, mParts ) {
+    if ( part.startsWith( QLatin1String( AKONADI_PARAM_PLD ) ) ) {
+      parts << part.mid( 4 );
+    }
+  }
+
+  qint64 lastCollectionId = -1;
+  QList<ItemRetrievalRequest *> requests;
+  QSet<qint64> requestedIds;
+
+  try {
+    // resolve the whole tree upfront, so all missing parts are found with
+    // few queries and can be retrieved in as few batches as possible
+    if ( mRecursive && mCollection.isValid() && mScope.scope() == Scope::Invalid ) {
+      QVariantList collections;
+      QVariantList virtualCollections;
+      collectionTree( collections, virtualCollections );
+
+      // leave room for the other values bound by buildQuery()
+      const int maxIds = QueryBuilder::maxBindValues( DbType::type( DataStore::self()->database() ) ) / 2;
+      for ( int i = 0; i < 2; ++i ) {
+        mCollectionTreeIsVirtual = ( i == 1 );
+        const QVariantList &tree = mCollectionTreeIsVirtual ? virtualCollections : collections;
+        for ( int offset = 0; offset < tree.size(); offset += maxIds ) {
+          mCollectionTree = tree.mid( offset, maxIds );
+          collectRequests( parts, requests, requestedIds, lastCollectionId );
+        }
+      }
+      mCollectionTree.clear();
+    } else {
+      collectRequests( parts, requests, requestedIds, lastCollectionId );
+    }
+  } catch ( ... ) {
+    mCollectionTree.clear();
+    qDeleteAll( requests );
+    throw;
+  }
+
+  // a single item requested interactively, most likely opened by the user
+  const qint64 openedItemId = ( requests.size() == 1 && mPriority == ItemRetrievalRequest::InteractivePriority ) ? requests.first()->id : -1;
 
+  QList<ItemRetrievalRequest *> pendingRequests;
   Q_FOREACH ( ItemRetrievalRequest *request, requests ) {
     if ( request->parts.isEmpty() ) {
         delete request;
         continue;
     }
-    // TODO: how should we handle retrieval errors here? so far they have been ignored,
-    // which makes sense in some cases, do we need a command parameter for this?
-    try {
-      ItemRetrievalManager::instance()->requestItemDelivery( request );
-    } catch ( const ItemRetrieverException &e ) {
-      akError() << e.type() << ": " << e.what();
-      mLastError = e.what();
-      return false;
-    }
+    pendingRequests << request;
+  }
+
+  if ( openedItemId >= 0 ) {
+    ItemRetrievalManager::instance()->itemOpened( openedItemId, pendingRequests.isEmpty() );
+  }
+
+  // TODO: how should we handle retrieval errors here? so far they have been ignored,
+  // which makes sense in some cases, do we need a command parameter for this?
+  try {
+    // the resource needs a free slot to deliver the items
+    const CommandThrottle::Suspender suspender;
+    // post all requests at once, so they can be sent to the resources in batches
+    ItemRetrievalManager::instance()->requestItemsDelivery( pendingRequests );
+  } catch ( const ItemRetrieverException &e ) {
+    akError() << e.type() << ": " << e.what();
+    mLastError = e.what();
+    return false;
+  }
+
+  if ( openedItemId >= 0 ) {
+    prefetchNeighbours( openedItemId, lastCollectionId, parts );
+  }
+
+  return true;
+}
+
+void ItemRetriever::prefetchNeighbours( qint64 itemId, qint64 collectionId, const QStringList &parts ) const
+{
+  Collection collection = Collection::retrieveById( collectionId );
+  if ( !collection.isValid() || parts.isEmpty() ) {
+    return;
+  }
+  DataStore::self()->activeCachePolicy( collection );
+  const int count = collection.cachePolicyPrefetch();
+  if ( count <= 0 ) {
+    return;
   }
 
-  // retrieve items in child collections if requested
-  bool result = true;
-  if ( mRecursive && mCollection.isValid() ) {
-    Q_FOREACH ( const Collection &col, mCollection.children() ) {
-      ItemRetriever retriever( mConnection );
-      retriever.setCollection( col, mRecursive );
-      retriever.setRetrieveParts( mParts );
-      retriever.setRetrieveFullPayload( mFullPayload );
-      result = retriever.exec();
-      if ( !result ) {
+  QList<ItemRetrievalRequest *> requests;
+  try {
+    QVariantList partTypeIds;
+    Q_FOREACH ( const QString &part, parts ) {
+      partTypeIds << PartTypeHelper::fromFqName( QLatin1String( "PLD" ), part ).id();
+    }
+
+    const QString resourceId = collection.resource().name();
+    // the next and the previous items, closest first
+    for ( int i = 0; i < 2; ++i ) {
+      const bool next = ( i == 0 );
+
+      QueryBuilder qb( PimItem::tableName() );
+      qb.addJoin( QueryBuilder::InnerJoin, MimeType::tableName(), PimItem::mimeTypeIdFullColumnName(), MimeType::idFullColumnName() );
+      Query::Condition cachedPartCondition;
+      cachedPartCondition.addColumnCondition( Part::pimItemIdFullColumnName(), Query::Equals, PimItem::idFullColumnName() );
+      cachedPartCondition.addValueCondition( Part::partTypeIdFullColumnName(), Query::In, partTypeIds );
+      cachedPartCondition.addValueCondition( Part::datasizeFullColumnName(), Query::Greater, 0 );
+      qb.addJoin( QueryBuilder::LeftJoin, Part::tableName(), cachedPartCondition );
+
+      qb.addColumn( PimItem::idFullColumnName() );
+      qb.addColumn( PimItem::remoteIdFullColumnName() );
+      qb.addColumn( PimItem::revFullColumnName() );
+      qb.addColumn( MimeType::nameFullColumnName() );
+
+      qb.addValueCondition( PimItem::collectionIdFullColumnName(), Query::Equals, collection.id() );
+      qb.addValueCondition( PimItem::idFullColumnName(), next ? Query::Greater : Query::Less, itemId );
+      qb.addValueCondition( PimItem::remoteIdFullColumnName(), Query::IsNot, QVariant() );
+      // none of the requested parts cached
+      qb.addValueCondition( Part::idFullColumnName(), Query::Is, QVariant() );
+      qb.addSortColumn( PimItem::idFullColumnName(), next ? Query::Ascending : Query::Descending );
+      qb.setLimit( count );
+
+      if ( !qb.exec() ) {
+        akError() << "Unable to query items to prefetch";
         break;
       }
+      QSqlQuery query = qb.query();
+      while ( query.next() ) {
+        ItemRetrievalRequest *request = new ItemRetrievalRequest();
+        request->id = query.value( 0 ).toLongLong();
+        request->remoteId = Utils::variantToByteArray( query.value( 1 ) );
+        request->revision = query.value( 2 ).toInt();
+        request->mimeType = Utils::variantToByteArray( query.value( 3 ) );
+        request->resourceId = resourceId;
+        request->parts = parts;
+        requests << request;
+      }
+      query.finish();
     }
+  } catch ( const Exception &e ) {
+    // prefetching is best effort only
+    akError() << "Unable to prefetch items:" << e.what();
   }
 
-  return result;
+  ItemRetrievalManager::instance()->prefetchItems( requests );
 }
 
 void ItemRetriever::verifyCache()
@@ -294,11 +489,7 @@ void ItemRetriever::verifyCache()
   qb.addJoin( QueryBuilder::InnerJoin, PimItem::tableName(), Part::pimItemIdFullColumnName(), PimItem::idFullColumnName() );
   qb.addValueCondition( Part::externalFullColumnName(), Query::Equals, true );
   qb.addValueCondition( Part::dataFullColumnName(), Query::IsNot, QVariant() );
-  if ( mScope.scope() != Scope::Invalid ) {
-    ItemQueryHelper::scopeToQuery( mScope, mConnection->context(), qb );
-  } else {
-    ItemQueryHelper::itemSetToQuery( mItemSet, qb, mCollection );
-  }
+  itemsToQuery( qb );
 
   if ( !qb.exec() ) {
     mLastError = "Unable to query parts.";
@@ -23,9 +23,11 @@
 #include "../exception.h"
 #include "entities.h"
 #include "handler/scope.h"
+#include "itemretrievalrequest.h"
 
 #include "libs/imapset_p.h"
 
+#include <QSet>
 #include <QStringList>
 
 AKONADI_EXCEPTION_MAKE_INSTANCE( ItemRetrieverException );
@@ -55,6 +57,12 @@ class ItemRetriever
     QStringList retrieveParts() const;
     void setRetrieveFullPayload( bool fullPayload );
     void setChangedSince( const QDateTime &changedSince );
+    /**
+     * Sets the priority class of the retrieval requests. Defaults to
+     * background priority for indexing agents, interactive otherwise.
+     */
+    void setPriority( ItemRetrievalRequest::Priority priority );
+    ItemRetrievalRequest::Priority priority() const;
     void setItemSet( const ImapSet &set, const Collection &collection = Collection() );
     void setItemSet( const ImapSet &set, bool isUid );
     void setItem( const Entity::Id &id );
@@ -72,6 +80,32 @@ class ItemRetriever
   private:
     QSqlQuery buildQuery() const;
 
+    /**
+     * Restricts @p qb to the items to retrieve, i.e. those in mScope, mItemSet
+     * or the collection tree below mCollection.
+     */
+    void itemsToQuery( QueryBuilder &qb ) const;
+
+    /**
+     * Creates the retrieval requests for the items matched by itemsToQuery()
+     * that have missing parts. Items in @p requestedIds are skipped, the ids
+     * of the new requests are added to it.
+     */
+    void collectRequests( const QStringList &parts, QList<ItemRetrievalRequest *> &requests,
+                          QSet<qint64> &requestedIds, qint64 &lastCollectionId );
+
+    /**
+     * Resolves the ids of mCollection and all its descendants with one query
+     * per tree level, separated into real and virtual collections.
+     */
+    void collectionTree( QVariantList &collections, QVariantList &virtualCollections ) const;
+
+    /**
+     * Queues retrieval of the uncached items next to @p itemId in its
+     * collection, according to the collection's prefetch cache policy.
+     */
+    void prefetchNeighbours( qint64 itemId, qint64 collectionId, const QStringList &parts ) const;
+
     /**
      * Checks if external files are still present
      * This costs extra, but allows us to automatically recover from something changing the external file storage.
@@ -85,7 +119,12 @@ class ItemRetriever
     QStringList mParts;
     bool mFullPayload;
     bool mRecursive;
+    /// the part of mCollection and its descendants currently queried during recursive retrieval
+    QVariantList mCollectionTree;
+    /// whether mCollectionTree contains virtual collections, whose items are linked
+    bool mCollectionTreeIsVirtual;
     QDateTime mChangedSince;
+    ItemRetrievalRequest::Priority mPriority;
     mutable QByteArray mLastError;
 };
 
@@ -21,6 +21,7 @@
 #include "storage/datastore.h"
 #include "storage/entity.h"
 #include "storage/collectionstatistics.h"
+#include "storage/itemretrievalmanager.h"
 #include "handlerhelper.h"
 #include "cachecleaner.h"
 #include "intervalcheck.h"
@@ -65,6 +66,9 @@ void NotificationCollector::itemChanged( const PimItem &item,
                                          const QByteArray &resource )
 {
   SearchManager::instance()->scheduleSearchUpdate();
+  if ( ItemRetrievalManager::instance() ) {
+    ItemRetrievalManager::instance()->invalidateFailedRetrievals( QVector<qint64>() << item.id() );
+  }
   itemNotification( NotificationMessageV2::Modify, item, collection, Collection(), resource, changedParts );
 }
 
@@ -153,6 +153,54 @@ bool PartHelper::insert( Part *part, qint64 *insertId )
   return result;
 }
 
+bool PartHelper::insert( QVector<Part> &parts )
+{
+  const qint64 sizeThreshold = DbConfig::configuredDatabase()->sizeThreshold();
+
+  QVariantList pimItemIds;
+  QVariantList partTypeIds;
+  QVariantList data;
+  QVariantList dataSizes;
+  QVariantList versions;
+  QVariantList external;
+  for ( QVector<Part>::iterator it = parts.begin(); it != parts.end(); ++it ) {
+    if ( it->datasize() > sizeThreshold ) {
+      // the file name of the payload needs the id of the part
+      if ( !insert( &( *it ) ) ) {
+        return false;
+      }
+      continue;
+    }
+
+    it->setExternal( false );
+    pimItemIds << it->pimItemId();
+    partTypeIds << it->partTypeId();
+    data << it->data();
+    dataSizes << it->datasize();
+    versions << it->version();
+    external << false;
+  }
+
+  if ( pimItemIds.isEmpty() ) {
+    return true;
+  }
+
+  QueryBuilder qb( Part::tableName(), QueryBuilder::Insert );
+  qb.setBulkInsert( true );
+  qb.setColumnValue( Part::pimItemIdColumn(), pimItemIds );
+  qb.setColumnValue( Part::partTypeIdColumn(), partTypeIds );
+  qb.setColumnValue( Part::dataColumn(), data );
+  qb.setColumnValue( Part::datasizeColumn(), dataSizes );
+  qb.setColumnValue( Part::versionColumn(), versions );
+  qb.setColumnValue( Part::externalColumn(), external );
+  if ( !qb.exec() ) {
+    akDebug() << "Error during insertion of parts" << qb.query().lastError().text();
+    return false;
+  }
+
+  return true;
+}
+
 bool PartHelper::remove( Part *part )
 {
   if ( !part ) {
@@ -209,9 +257,8 @@ bool PartHelper::streamToFile( ImapStreamParser* streamParser, QFile &file, QIOD
     Q_ASSERT( file.openMode() & QIODevice::WriteOnly );
   }
 
-  QByteArray value;
   while ( !streamParser->atLiteralEnd() ) {
-    value = streamParser->readLiteralPart();
+    const QByteArray value = streamParser->readLiteralPartView();
     if ( file.write( value ) != value.size() ) {
       throw PartHelperException( "Unable to write payload to file" );
     }
@@ -60,6 +60,13 @@ namespace PartHelper
    */
   bool insert( Part *part, qint64 *insertId = 0 );
 
+  /**
+   * Adds all @p parts to the database and if necessary to the filesystem.
+   * Parts stored in the database are inserted at once and their id is not
+   * set, only the parts stored in the filesystem get their id.
+   */
+  bool insert( QVector<Part> &parts );
+
   /** Deletes @p part from the database and also removes existing filesystem data if needed. */
   bool remove( Part *part );
   /** Deletes all parts which match the given constraint, including all corresponding filesystem data. */
@@ -112,7 +112,7 @@ bool PartStreamer::streamLiteral(Part& part, qint64& partSize, QByteArray& value
         mStreamParser->sendContinuationResponse(dataSize);
         //don't write in streaming way as the data goes to the database
         while (!mStreamParser->atLiteralEnd()) {
-            value += mStreamParser->readLiteralPart();
+            value += mStreamParser->readLiteralPartView();
         }
         if (part.isValid()) {
             PartHelper::update(&part, value, value.size());
@@ -95,6 +95,39 @@ static void appendJoined( QString *statement, const QStringList &strings, const
   }
 }
 
+// Maximum number of rows inserted by a single bulk INSERT statement
+#define BULK_INSERT_MAX_ROWS 256
+// SQLITE_MAX_VARIABLE_NUMBER of a default SQLite build
+#define SQLITE_MAX_BIND_VALUES 999
+// Parameter limit of the PostgreSQL client protocol, MySQL allows more
+#define MAX_BIND_VALUES 32767
+
+// FNV-1a, applied to 16 bit units
+#define FNV_OFFSET_BASIS Q_UINT64_C( 14695981039346656037 )
+#define FNV_PRIME Q_UINT64_C( 1099511628211 )
+
+static inline void hashAppend( quint64 *hash, quint64 value )
+{
+  *hash = ( *hash ^ value ) * FNV_PRIME;
+}
+
+static inline void hashAppendString( quint64 *hash, const QString &string )
+{
+  hashAppend( hash, string.size() );
+  const ushort *data = string.utf16();
+  for ( int i = 0, c = string.size(); i < c; ++i ) {
+    hashAppend( hash, data[i] );
+  }
+}
+
+static inline void hashAppendStrings( quint64 *hash, const QStringList &strings )
+{
+  hashAppend( hash, strings.size() );
+  for ( int i = 0, c = strings.size(); i < c; ++i ) {
+    hashAppendString( hash, strings.at( i ) );
+  }
+}
+
 QueryBuilder::QueryBuilder( const QString &table, QueryBuilder::QueryType type )
    : mTable( table )
 #ifndef QUERYBUILDER_UNITTEST
@@ -107,6 +140,9 @@ QueryBuilder::QueryBuilder( const QString &table, QueryBuilder::QueryType type )
    , mIdentificationColumn(  )
    , mLimit( -1 )
    , mDistinct( false )
+   , mForwardOnly( false )
+   , mBulkInsert( false )
+   , mBulkInsertRows( 0 )
 {
   static const QString defaultIdColumn = QLatin1String( "id" );
   mIdentificationColumn = defaultIdColumn;
@@ -117,6 +153,11 @@ void QueryBuilder::setDatabaseType( DbType::Type type )
   mDatabaseType = type;
 }
 
+int QueryBuilder::maxBindValues( DbType::Type type )
+{
+  return type == DbType::Sqlite ? SQLITE_MAX_BIND_VALUES : MAX_BIND_VALUES;
+}
+
 void QueryBuilder::addJoin( JoinType joinType, const QString &table, const Query::Condition &condition )
 {
   Q_ASSERT( ( joinType == InnerJoin && ( mType == Select || mType == Update ) ) ||
@@ -236,14 +277,41 @@ void QueryBuilder::buildQuery(QString *statement)
         *statement += QLatin1String( ", " );
       }
     }
-    *statement += QLatin1String( ") VALUES (" );
-    for (int i = 0, c = mColumnValues.size(); i < c; ++i) {
-      bindValue( statement, mColumnValues.at(i).second );
-      if (i + 1 < c) {
-        *statement += QLatin1String( ", " );
+    *statement += QLatin1Char( ')' );
+    if ( mBulkInsertRows > 0 ) {
+      QVector<QVariantList> values;
+      values.reserve( mColumnValues.size() );
+      for (int i = 0, c = mColumnValues.size(); i < c; ++i) {
+        values << mColumnValues.at(i).second.toList();
+      }
+      // Multi-row VALUES need SQLite 3.7.11, compound SELECTs work with any version
+      const bool compoundSelect = ( mDatabaseType == DbType::Sqlite );
+      for (int row = 0; row < mBulkInsertRows; ++row) {
+        if ( compoundSelect ) {
+          *statement += row == 0 ? QLatin1String( " SELECT " ) : QLatin1String( " UNION ALL SELECT " );
+        } else {
+          *statement += row == 0 ? QLatin1String( " VALUES (" ) : QLatin1String( ", (" );
+        }
+        for (int i = 0, c = values.size(); i < c; ++i) {
+          bindValue( statement, values.at(i).at(row) );
+          if (i + 1 < c) {
+            *statement += QLatin1String( ", " );
+          }
+        }
+        if ( !compoundSelect ) {
+          *statement += QLatin1Char( ')' );
+        }
+      }
+    } else {
+      *statement += QLatin1String( " VALUES (" );
+      for (int i = 0, c = mColumnValues.size(); i < c; ++i) {
+        bindValue( statement, mColumnValues.at(i).second );
+        if (i + 1 < c) {
+          *statement += QLatin1String( ", " );
+        }
       }
+      *statement += QLatin1Char( ')' );
     }
-    *statement += QLatin1Char( ')' );
     if ( mDatabaseType == DbType::PostgreSQL && !mIdentificationColumn.isEmpty() ) {
       *statement += QLatin1String( " RETURNING " ) + mIdentificationColumn;
     }
@@ -346,18 +414,97 @@ bool QueryBuilder::retryLastTransaction( bool rollback )
 }
 
 
+bool QueryBuilder::execBulkInsert()
+{
+  QVector<QVariantList> values;
+  values.reserve( mColumnValues.size() );
+  for ( int i = 0, c = mColumnValues.size(); i < c; ++i ) {
+    values << mColumnValues.at( i ).second.toList();
+    Q_ASSERT_X( values.last().size() == values.first().size(), "QueryBuilder::execBulkInsert()",
+                "All columns need the same number of values" );
+  }
+  Q_ASSERT_X( !values.isEmpty(), "QueryBuilder::execBulkInsert()", "No columns specified" );
+
+  const int maxRows = qMin( BULK_INSERT_MAX_ROWS, maxBindValues( mDatabaseType ) / values.size() );
+
+  const int rows = values.first().size();
+  int offset = 0;
+  while ( offset < rows ) {
+    // only use powers of two as row counts, so that there are just a few
+    // different statements to prepare and to cache
+    const int remaining = qMin( rows - offset, maxRows );
+    int chunkRows = 1;
+    while ( chunkRows * 2 <= remaining ) {
+      chunkRows *= 2;
+    }
+
+    QueryBuilder qb( mTable, Insert );
+    qb.setDatabaseType( mDatabaseType );
+    qb.setIdentificationColumn( QString() );
+    qb.mBulkInsertRows = chunkRows;
+    for ( int i = 0, c = mColumnValues.size(); i < c; ++i ) {
+      qb.setColumnValue( mColumnValues.at( i ).first, values.at( i ).mid( offset, chunkRows ) );
+    }
+    const bool ok = qb.exec();
+    mQuery = qb.mQuery;
+#ifdef QUERYBUILDER_UNITTEST
+    if ( !mStatement.isEmpty() ) {
+      mStatement += QLatin1String( "; " );
+    }
+    mStatement += qb.mStatement;
+    mBindValues += qb.mBindValues;
+#endif
+    if ( !ok ) {
+      return false;
+    }
+    offset += chunkRows;
+  }
+
+  return true;
+}
+
 bool QueryBuilder::exec()
 {
+  if ( mType == Insert && mBulkInsert && mBulkInsertRows == 0 ) {
+    return execBulkInsert();
+  }
+
   QString statement;
-  statement.reserve(1024);
-  buildQuery(&statement);
 
 #ifndef QUERYBUILDER_UNITTEST
-  if ( QueryCache::contains( statement ) ) {
-    mQuery = QueryCache::query( statement );
+  // queries of a known shape only differ in their bind values, there is
+  // no need to generate their statement again
+  const quint64 shape = shapeFingerprint();
+  if ( shape != 0 && QueryCache::contains( shape ) ) {
+    mQuery = QueryCache::query( shape );
+    statement = mQuery.lastQuery();
+#ifndef QT_NO_DEBUG
+    const int bindValuesCount = mBindValues.count();
+#endif
+    collectBindValues();
+#ifndef QT_NO_DEBUG
+    QueryBuilder verify( *this );
+    verify.mBindValues.resize( bindValuesCount );
+    QString verifyStatement;
+    verify.buildQuery( &verifyStatement );
+    Q_ASSERT_X( verifyStatement == statement && verify.mBindValues == mBindValues,
+                "QueryBuilder::exec()", "Query shape fingerprint does not match the statement" );
+#endif
   } else {
-    mQuery.prepare( statement );
-    QueryCache::insert( statement, mQuery );
+    statement.reserve( 1024 );
+    buildQuery( &statement );
+    const bool cached = QueryCache::contains( statement );
+    if ( cached ) {
+      mQuery = QueryCache::query( statement );
+    } else {
+      mQuery.prepare( statement );
+    }
+    if ( !cached || shape != 0 ) {
+      QueryCache::insert( statement, mQuery, shape );
+    }
+  }
+  if ( mQuery.isForwardOnly() != mForwardOnly ) {
+    mQuery.setForwardOnly( mForwardOnly );
   }
 
   //too heavy debug info but worths to have from time to time
@@ -442,6 +589,8 @@ bool QueryBuilder::exec()
     return false;
   }
 #else
+  statement.reserve(1024);
+  buildQuery(&statement);
   mStatement = statement;
 #endif
   return true;
@@ -540,6 +689,130 @@ void QueryBuilder::buildCaseStatement(QString *query, const Query::Case &caseStm
     *query += QLatin1String(" END");
 }
 
+quint64 QueryBuilder::shapeFingerprint() const
+{
+  // SQLite gets the join conditions of an UPDATE as subqueries, whose
+  // bind values are not part of this query
+  if ( mType == Update && mDatabaseType == DbType::Sqlite && !mJoinedTables.isEmpty() ) {
+    return 0;
+  }
+
+  quint64 hash = FNV_OFFSET_BASIS;
+  hashAppend( &hash, mType );
+  hashAppend( &hash, mDatabaseType );
+  hashAppendString( &hash, mTable );
+  hashAppend( &hash, mDistinct );
+  hashAppend( &hash, mLimit );
+  hashAppendString( &hash, mIdentificationColumn );
+  hashAppendStrings( &hash, mColumns );
+  hashAppendStrings( &hash, mJoinedTables );
+  Q_FOREACH ( const QString &joinedTable, mJoinedTables ) {
+    const QPair<JoinType, Query::Condition> &join = mJoins.value( joinedTable );
+    hashAppend( &hash, join.first );
+    hashCondition( &hash, join.second );
+  }
+  hashAppend( &hash, mBulkInsertRows );
+  hashAppend( &hash, mColumnValues.size() );
+  for ( int i = 0, c = mColumnValues.size(); i < c; ++i ) {
+    hashAppendString( &hash, mColumnValues.at( i ).first );
+  }
+  hashCondition( &hash, mRootCondition[WhereCondition] );
+  hashCondition( &hash, mRootCondition[HavingCondition] );
+  hashAppendStrings( &hash, mGroupColumns );
+  hashAppend( &hash, mSortColumns.size() );
+  for ( int i = 0, c = mSortColumns.size(); i < c; ++i ) {
+    hashAppendString( &hash, mSortColumns.at( i ).first );
+    hashAppend( &hash, mSortColumns.at( i ).second );
+  }
+
+  // 0 is reserved for "no fingerprint"
+  return hash != 0 ? hash : 1;
+}
+
+void QueryBuilder::hashCondition( quint64 *hash, const Query::Condition &cond ) const
+{
+  hashAppend( hash, cond.isEmpty() );
+  if ( !cond.isEmpty() ) {
+    hashAppend( hash, cond.mCombineOp );
+    hashAppend( hash, cond.mSubConditions.size() );
+    for ( int i = 0, c = cond.mSubConditions.size(); i < c; ++i ) {
+      hashCondition( hash, cond.mSubConditions.at( i ) );
+    }
+  } else {
+    hashAppendString( hash, cond.mColumn );
+    hashAppend( hash, cond.mCompareOp );
+    hashAppendString( hash, cond.mComparedColumn );
+    // the statement depends on whether the value is NULL or a list, and on the
+    // length of that list, but not on the value itself
+    if ( !cond.mComparedValue.isValid() ) {
+      hashAppend( hash, -1 );
+    } else if ( cond.mComparedValue.canConvert( QVariant::List ) ) {
+      hashAppend( hash, cond.mComparedValue.toList().size() );
+    } else {
+      hashAppend( hash, -2 );
+    }
+  }
+}
+
+void QueryBuilder::collectBindValues()
+{
+  switch ( mType ) {
+  case Select:
+    Q_FOREACH ( const QString &joinedTable, mJoinedTables ) {
+      collectBindValues( mJoins.value( joinedTable ).second );
+    }
+    break;
+  case Insert:
+    if ( mBulkInsertRows > 0 ) {
+      QVector<QVariantList> values;
+      values.reserve( mColumnValues.size() );
+      for ( int i = 0, c = mColumnValues.size(); i < c; ++i ) {
+        values << mColumnValues.at( i ).second.toList();
+      }
+      for ( int row = 0; row < mBulkInsertRows; ++row ) {
+        for ( int i = 0, c = values.size(); i < c; ++i ) {
+          mBindValues << values.at( i ).at( row );
+        }
+      }
+      break;
+    }
+    // fall through
+  case Update:
+    for ( int i = 0, c = mColumnValues.size(); i < c; ++i ) {
+      mBindValues << mColumnValues.at( i ).second;
+    }
+    break;
+  case Delete:
+    break;
+  }
+
+  collectBindValues( mRootCondition[WhereCondition] );
+  if ( mType == Update ) {
+    // buildQuery() puts the ON conditions into the WHERE part of an UPDATE query
+    Q_FOREACH ( const QString &joinedTable, mJoinedTables ) {
+      collectBindValues( mJoins.value( joinedTable ).second );
+    }
+  }
+  collectBindValues( mRootCondition[HavingCondition] );
+}
+
+void QueryBuilder::collectBindValues( const Query::Condition &cond )
+{
+  if ( !cond.isEmpty() ) {
+    for ( int i = 0, c = cond.mSubConditions.size(); i < c; ++i ) {
+      collectBindValues( cond.mSubConditions.at( i ) );
+    }
+  } else if ( cond.mComparedColumn.isEmpty() && cond.mComparedValue.isValid() ) {
+    if ( cond.mComparedValue.canConvert( QVariant::List ) ) {
+      Q_FOREACH ( const QVariant &entry, cond.mComparedValue.toList() ) {
+        mBindValues << entry;
+      }
+    } else {
+      mBindValues << cond.mComparedValue;
+    }
+  }
+}
+
 void QueryBuilder::setSubQueryMode( Query::LogicOperator op, ConditionType type )
 {
   Q_ASSERT( type == WhereCondition || ( type == HavingCondition && mType == Select ) );
@@ -584,6 +857,17 @@ void QueryBuilder::setLimit( int limit )
   mLimit = limit;
 }
 
+void QueryBuilder::setForwardOnly( bool forwardOnly )
+{
+  mForwardOnly = forwardOnly;
+}
+
+void QueryBuilder::setBulkInsert( bool bulkInsert )
+{
+  Q_ASSERT( mType == Insert );
+  mBulkInsert = bulkInsert;
+}
+
 void QueryBuilder::setIdentificationColumn( const QString &column )
 {
   mIdentificationColumn = column;
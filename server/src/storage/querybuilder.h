@@ -88,6 +88,12 @@ class QueryBuilder
     */
     void setDatabaseType( DbType::Type type );
 
+    /**
+      Returns the maximum number of values that can be bound to a single
+      statement on a database of the given @p type.
+    */
+    static int maxBindValues( DbType::Type type );
+
     /**
       Join a table to the query.
 
@@ -220,6 +226,14 @@ class QueryBuilder
      */
     void setLimit( int limit );
 
+    /**
+     * Sets whether the results of a SELECT query will only be iterated forward.
+     * This allows the database driver to drop rows that have been read already
+     * instead of caching the whole result set.
+     * @param forwardOnly @c true for forward-only access, @c false is the default
+     */
+    void setForwardOnly( bool forwardOnly );
+
     /**
      * Sets the column used for identification in an INSERT statement.
      * The default is "id", only change this on tables without such a column
@@ -230,6 +244,15 @@ class QueryBuilder
      */
     void setIdentificationColumn( const QString &column );
 
+    /**
+     * Inserts all rows with multi-row INSERT statements, instead of executing
+     * the statement once for each row. All column values must be lists of the
+     * same length. The rows are split into several statements to stay within
+     * the limits of the database.
+     * @note insertId() is not available for such queries.
+     */
+    void setBulkInsert( bool bulkInsert );
+
     /**
       Returns the query, only valid after exec().
     */
@@ -254,6 +277,22 @@ class QueryBuilder
     void buildWhereCondition( QString *query, const Query::Condition &cond );
     void buildCaseStatement( QString *query, const Query::Case &caseStmt );
 
+    /**
+     * Returns a hash of everything that determines the statement generated by
+     * buildQuery(), except the bound values. Queries of the same shape share
+     * their prepared statement.
+     * @returns 0 if the statement of this query cannot be memoized
+     */
+    quint64 shapeFingerprint() const;
+    void hashCondition( quint64 *hash, const Query::Condition &cond ) const;
+
+    /**
+     * Collects the bind values in the same order as buildQuery(), without
+     * generating the statement.
+     */
+    void collectBindValues();
+    void collectBindValues( const Query::Condition &cond );
+
     /**
      * SQLite does not support JOINs with UPDATE, so we have to convert it into
      * subqueries
@@ -262,6 +301,8 @@ class QueryBuilder
 
     bool retryLastTransaction( bool rollback = false);
 
+    bool execBulkInsert();
+
   private:
     QString mTable;
     DbType::Type mDatabaseType;
@@ -281,6 +322,10 @@ class QueryBuilder
     QMap< QString, QPair< JoinType, Query::Condition > > mJoins;
     int mLimit;
     bool mDistinct;
+    bool mForwardOnly;
+    bool mBulkInsert;
+    /// Number of rows inserted by the generated statement, 0 for a plain INSERT
+    int mBulkInsertRows;
 #ifdef QUERYBUILDER_UNITTEST
     QString mStatement;
     friend class ::QueryBuilderTest;
@@ -21,15 +21,26 @@
 #include "dbtype.h"
 #include "datastore.h"
 
+#include <akstandarddirs.h>
+
+#include <QSettings>
 #include <QSqlQuery>
 #include <QThreadStorage>
+#include <QtCore/QAtomicInt>
 #include <QtCore/QHash>
+#include <QtCore/QLinkedList>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
 #include <QtCore/QTimer>
 
 using namespace Akonadi::Server;
 
-// After these seconds without activity the cache is cleaned
-#define CLEANUP_TIMEOUT 30 // seconds
+// Maximum number of prepared queries kept per thread, unless configured otherwise.
+// Every connection thread has a cache of its own, the total must stay well below
+// the limit of the database server, e.g. MySQL's max_prepared_stmt_count (16382)
+#define CACHE_CAPACITY 200
+// After these seconds without activity the cache is cleaned, unless configured otherwise
+#define CLEANUP_TIMEOUT 300 // seconds
 
 class Cache : public QObject
 {
@@ -37,28 +48,195 @@ class Cache : public QObject
 public:
 
   Cache()
+    : m_thread( QThread::currentThread() )
   {
-    connect( &m_cleanupTimer, SIGNAL(timeout()), SLOT(cleanup()));
+    const QSettings settings( AkStandardDirs::serverConfigFile(), QSettings::IniFormat );
+    m_capacity = settings.value( QLatin1String( "QueryCache/Capacity" ), CACHE_CAPACITY ).toInt();
+    // releases the prepared statements of idle threads, 0 keeps them
+    m_cleanupTimeout = settings.value( QLatin1String( "QueryCache/IdleTimeout" ), CLEANUP_TIMEOUT ).toInt() * 1000;
+
+    connect( &m_cleanupTimer, SIGNAL(timeout()), SLOT(cleanup()) );
     m_cleanupTimer.setSingleShot( true );
+
+    // The stock QSQLITE driver discards a statement whose last execution failed,
+    // only our QSQLITE3 driver can safely execute a prepared statement again.
+    const QSqlDatabase db = DataStore::self()->database();
+    m_enabled = m_capacity > 0 && ( DbType::type( db ) != DbType::Sqlite || db.driverName() == QLatin1String( "QSQLITE3" ) );
+
+    QMutexLocker locker( &s_cachesLock );
+    s_caches.append( this );
+  }
+
+  ~Cache()
+  {
+    cleanup();
+
+    QMutexLocker locker( &s_cachesLock );
+    s_caches.removeOne( this );
+  }
+
+  bool contains( const QString &queryStatement )
+  {
+    if ( !m_enabled ) {
+      return false;
+    }
+    if ( m_cache.contains( queryStatement ) ) {
+      m_hits.ref();
+      return true;
+    }
+    m_misses.ref();
+    return false;
+  }
+
+  bool contains( quint64 shape )
+  {
+    if ( !m_enabled || !m_shapes.contains( shape ) ) {
+      return false;
+    }
+    m_hits.ref();
+    return true;
   }
 
   QSqlQuery query( const QString &queryStatement )
   {
-    m_cleanupTimer.start( CLEANUP_TIMEOUT * 1000 );
-    return m_cache.value( queryStatement );
+    return use( m_cache.value( queryStatement ) );
+  }
+
+  QSqlQuery query( quint64 shape )
+  {
+    return use( m_shapes.value( shape ) );
+  }
+
+  void insert( const QString &queryStatement, const QSqlQuery &query, quint64 shape )
+  {
+    if ( !m_enabled ) {
+      return;
+    }
+    if ( m_cleanupTimeout > 0 ) {
+      m_cleanupTimer.start( m_cleanupTimeout );
+    }
+    Entry *entry = m_cache.value( queryStatement );
+    if ( entry ) {
+      m_lru.erase( entry->lruPosition );
+      if ( entry->shape != shape ) {
+        m_shapes.remove( entry->shape );
+      }
+    } else {
+      while ( m_cache.size() >= m_capacity ) {
+        remove( m_lru.first() );
+        m_evictions.ref();
+      }
+      entry = new Entry;
+      entry->statement = queryStatement;
+      m_cache.insert( queryStatement, entry );
+    }
+    entry->query = query;
+    entry->shape = shape;
+    entry->lruPosition = m_lru.insert( m_lru.end(), entry );
+    if ( shape != 0 ) {
+      Entry *&shapeEntry = m_shapes[shape];
+      if ( shapeEntry && shapeEntry != entry ) {
+        shapeEntry->shape = 0;
+      }
+      shapeEntry = entry;
+    }
+    m_size.fetchAndStoreRelaxed( m_cache.size() );
+  }
+
+  void finishQueries()
+  {
+    Q_FOREACH ( Entry *entry, m_lru ) {
+      if ( entry->query.isActive() ) {
+        entry->query.finish();
+      }
+    }
   }
 
 public Q_SLOTS:
   void cleanup()
   {
+    qDeleteAll( m_lru );
     m_cache.clear();
+    m_shapes.clear();
+    m_lru.clear();
+    m_size.fetchAndStoreRelaxed( 0 );
   }
 
-public: // public, this is just a helper class
-  QHash<QString, QSqlQuery> m_cache;
+public:
+  /// Called from other threads, must only touch the atomic counters.
+  QVariantMap statistics() const
+  {
+    QVariantMap stats;
+    stats.insert( QLatin1String( "capacity" ), m_enabled ? m_capacity : 0 );
+    stats.insert( QLatin1String( "size" ), m_size.fetchAndAddRelaxed( 0 ) );
+    stats.insert( QLatin1String( "hits" ), m_hits.fetchAndAddRelaxed( 0 ) );
+    stats.insert( QLatin1String( "misses" ), m_misses.fetchAndAddRelaxed( 0 ) );
+    stats.insert( QLatin1String( "evictions" ), m_evictions.fetchAndAddRelaxed( 0 ) );
+    return stats;
+  }
+
+  QString name() const
+  {
+    QString name;
+    name.sprintf( "%s (%p)", qPrintable( m_thread->objectName() ), static_cast<void *>( m_thread ) );
+    return name;
+  }
+
+  static QMutex s_cachesLock;
+  static QList<Cache *> s_caches;
+
+private:
+  struct Entry
+  {
+    QString statement;
+    QSqlQuery query;
+    quint64 shape;
+    QLinkedList<Entry *>::Iterator lruPosition;
+  };
+
+  QSqlQuery use( Entry *entry )
+  {
+    if ( m_cleanupTimeout > 0 ) {
+      m_cleanupTimer.start( m_cleanupTimeout );
+    }
+    if ( !entry ) {
+      return QSqlQuery();
+    }
+    // mark as most recently used
+    m_lru.erase( entry->lruPosition );
+    entry->lruPosition = m_lru.insert( m_lru.end(), entry );
+    return entry->query;
+  }
+
+  void remove( Entry *entry )
+  {
+    m_lru.erase( entry->lruPosition );
+    m_cache.remove( entry->statement );
+    if ( entry->shape != 0 ) {
+      m_shapes.remove( entry->shape );
+    }
+    delete entry;
+  }
+
+  QHash<QString, Entry *> m_cache;
+  QHash<quint64, Entry *> m_shapes;
+  /// Owns the entries, least recently used first
+  QLinkedList<Entry *> m_lru;
+  QThread *m_thread;
   QTimer m_cleanupTimer;
+  int m_cleanupTimeout;
+  int m_capacity;
+  bool m_enabled;
+
+  mutable QAtomicInt m_size;
+  mutable QAtomicInt m_hits;
+  mutable QAtomicInt m_misses;
+  mutable QAtomicInt m_evictions;
 };
 
+QMutex Cache::s_cachesLock;
+QList<Cache *> Cache::s_caches;
+
 static QThreadStorage<Cache *> g_queryCache;
 
 static Cache *perThreadCache()
@@ -72,11 +250,12 @@ static Cache *perThreadCache()
 
 bool QueryCache::contains( const QString &queryStatement )
 {
-  if ( DbType::type( DataStore::self()->database() ) == DbType::Sqlite ) {
-    return false;
-  } else {
-    return perThreadCache()->m_cache.contains( queryStatement );
-  }
+  return perThreadCache()->contains( queryStatement );
+}
+
+bool QueryCache::contains( quint64 shape )
+{
+  return perThreadCache()->contains( shape );
 }
 
 QSqlQuery QueryCache::query( const QString &queryStatement )
@@ -84,11 +263,23 @@ QSqlQuery QueryCache::query( const QString &queryStatement )
   return perThreadCache()->query( queryStatement );
 }
 
-void QueryCache::insert( const QString &queryStatement, const QSqlQuery &query )
+QSqlQuery QueryCache::query( quint64 shape )
+{
+  return perThreadCache()->query( shape );
+}
+
+void QueryCache::insert( const QString &queryStatement, const QSqlQuery &query, quint64 shape )
+{
+  perThreadCache()->insert( queryStatement, query, shape );
+}
+
+void QueryCache::finishQueries()
 {
-  if ( DbType::type( DataStore::self()->database() ) != DbType::Sqlite ) {
-    perThreadCache()->m_cache.insert( queryStatement, query );
+  if (!g_queryCache.hasLocalData()) {
+    return;
   }
+
+  g_queryCache.localData()->finishQueries();
 }
 
 void QueryCache::clear()
@@ -100,5 +291,14 @@ void QueryCache::clear()
   g_queryCache.localData()->cleanup();
 }
 
+QVariantMap QueryCache::statistics()
+{
+  QVariantMap stats;
+  QMutexLocker locker( &Cache::s_cachesLock );
+  Q_FOREACH ( const Cache *cache, Cache::s_caches ) {
+    stats.insert( cache->name(), cache->statistics() );
+  }
+  return stats;
+}
 
 #include <querycache.moc>
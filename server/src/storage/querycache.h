@@ -20,6 +20,8 @@
 #ifndef AKONADI_QUERYCACHE_H
 #define AKONADI_QUERYCACHE_H
 
+#include <QtCore/QVariant>
+
 class QString;
 class QSqlQuery;
 
@@ -29,21 +31,50 @@ namespace Server {
 /**
  * A per-thread cache (should be per session, but that'S the same for us) prepared
  * query cache.
+ *
+ * The cache keeps the most recently used queries only, up to the number
+ * configured in QueryCache/Capacity. The cache of a thread is cleaned once it
+ * has not been used for QueryCache/IdleTimeout seconds, so idle connections
+ * don't keep their prepared statements open on the database server. With SQLite
+ * it requires the bundled QSQLITE3 driver.
  */
 namespace QueryCache
 {
   /// Check whether the query @p queryStatement is cached already.
   bool contains( const QString &queryStatement );
 
+  /// Check whether a query with the shape fingerprint @p shape is cached already.
+  bool contains( quint64 shape );
+
   /// Returns the cached (and prepared) query for @p queryStatement.
   QSqlQuery query( const QString &queryStatement );
 
-  /// Insert @p query into the cache for @p queryStatement.
-  void insert( const QString &queryStatement, const QSqlQuery &query );
+  /// Returns the cached (and prepared) query with the shape fingerprint @p shape.
+  QSqlQuery query( quint64 shape );
+
+  /**
+   * Insert @p query into the cache for @p queryStatement. Unless @p shape is 0,
+   * the query can also be looked up by that shape fingerprint.
+   * @see QueryBuilder::shapeFingerprint()
+   */
+  void insert( const QString &queryStatement, const QSqlQuery &query, quint64 shape = 0 );
+
+  /**
+   * Releases the result sets of all cached queries of the current thread.
+   * Call when none of them is in use anymore, as SQLite keeps the tables
+   * of a statement with an unfinished result set locked.
+   */
+  void finishQueries();
 
   /// Clears all queries from current thread
   void clear();
 
+  /**
+   * Returns capacity, size, hits, misses and evictions of the caches of all
+   * threads, keyed by thread name.
+   */
+  QVariantMap statistics();
+
 } // namespace QueryCache
 
 } // namespace Server
@@ -0,0 +1,128 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include "retrievalfailurecache.h"
+
+using namespace Akonadi::Server;
+
+static QStringList normalizedParts( const QStringList &parts )
+{
+  QStringList sorted = parts;
+  sorted.sort();
+  sorted.removeDuplicates();
+  return sorted;
+}
+
+RetrievalFailureCache::RetrievalFailureCache( qint64 timeout, int maxSize )
+  : mTimeout( timeout )
+  , mMaxSize( maxSize )
+  , mHits( 0 )
+  , mMisses( 0 )
+{
+}
+
+bool RetrievalFailureCache::isEnabled() const
+{
+  return mTimeout > 0 && mMaxSize > 0;
+}
+
+bool RetrievalFailureCache::lookup( qint64 id, int revision, const QStringList &parts, QString &errorMsg )
+{
+  if ( !isEnabled() ) {
+    return false;
+  }
+
+  const QStringList requestedParts = normalizedParts( parts );
+  QMultiHash<qint64, Failure>::Iterator it = mFailures.find( id );
+  while ( it != mFailures.end() && it.key() == id ) {
+    if ( it.value().revision != revision || it.value().age.hasExpired( mTimeout ) ) {
+      it = mFailures.erase( it );
+    } else if ( it.value().parts == requestedParts ) {
+      errorMsg = it.value().errorMsg;
+      ++mHits;
+      return true;
+    } else {
+      ++it;
+    }
+  }
+  ++mMisses;
+  return false;
+}
+
+void RetrievalFailureCache::insert( qint64 id, int revision, const QStringList &parts, const QString &errorMsg )
+{
+  if ( !isEnabled() ) {
+    return;
+  }
+
+  Failure failure;
+  failure.revision = revision;
+  failure.parts = normalizedParts( parts );
+  failure.errorMsg = errorMsg;
+  failure.age.start();
+
+  QMultiHash<qint64, Failure>::Iterator it = mFailures.find( id );
+  while ( it != mFailures.end() && it.key() == id ) {
+    if ( it.value().revision != revision || it.value().parts == failure.parts ) {
+      it = mFailures.erase( it );
+    } else {
+      ++it;
+    }
+  }
+
+  if ( mFailures.size() >= mMaxSize ) {
+    expire();
+  }
+  if ( mFailures.size() >= mMaxSize ) {
+    // all entries are recent, start over rather than tracking the oldest one
+    mFailures.clear();
+  }
+  mFailures.insert( id, failure );
+}
+
+void RetrievalFailureCache::invalidate( qint64 id )
+{
+  mFailures.remove( id );
+}
+
+void RetrievalFailureCache::expire()
+{
+  for ( QMultiHash<qint64, Failure>::Iterator it = mFailures.begin(); it != mFailures.end(); ) {
+    if ( it.value().age.hasExpired( mTimeout ) ) {
+      it = mFailures.erase( it );
+    } else {
+      ++it;
+    }
+  }
+}
+
+int RetrievalFailureCache::size() const
+{
+  return mFailures.size();
+}
+
+qint64 RetrievalFailureCache::hits() const
+{
+  return mHits;
+}
+
+qint64 RetrievalFailureCache::misses() const
+{
+  return mMisses;
+}
@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef AKONADI_SERVER_RETRIEVALFAILURECACHE_H
+#define AKONADI_SERVER_RETRIEVALFAILURECACHE_H
+
+#include <QElapsedTimer>
+#include <QMultiHash>
+#include <QStringList>
+
+namespace Akonadi {
+namespace Server {
+
+/**
+ * Remembers item retrievals a resource failed to deliver, like items that
+ * vanished from the server, so that retrying them does not cause another
+ * round-trip to the resource until the entry expired.
+ *
+ * Entries are keyed by item id, item revision and the set of requested parts,
+ * modifying an item therefore invalidates its entries implicitly.
+ *
+ * Not thread-safe, ItemRetrievalManager protects it with its lock.
+ */
+class RetrievalFailureCache
+{
+  public:
+    /**
+     * Creates a cache keeping failures for @p timeout milliseconds, 0 disables
+     * the cache, and at most @p maxSize of them.
+     */
+    RetrievalFailureCache( qint64 timeout, int maxSize );
+
+    bool isEnabled() const;
+
+    /**
+     * Returns true and the recorded error in @p errorMsg if retrieving @p parts
+     * of the given item revision failed recently.
+     */
+    bool lookup( qint64 id, int revision, const QStringList &parts, QString &errorMsg );
+
+    /** Records that retrieving @p parts of the given item revision failed. */
+    void insert( qint64 id, int revision, const QStringList &parts, const QString &errorMsg );
+
+    /** Forgets all failures of the item @p id. */
+    void invalidate( qint64 id );
+
+    int size() const;
+    qint64 hits() const;
+    qint64 misses() const;
+
+  private:
+    void expire();
+
+    struct Failure
+    {
+      int revision;
+      QStringList parts;
+      QString errorMsg;
+      QElapsedTimer age;
+    };
+
+    QMultiHash<qint64, Failure> mFailures;
+    qint64 mTimeout;
+    int mMaxSize;
+    qint64 mHits;
+    qint64 mMisses;
+};
+
+} // namespace Server
+} // namespace Akonadi
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "storagedebugger.h"
 #include "storagedebuggeradaptor.h"
+#include "querycache.h"
 
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlRecord>
@@ -64,6 +65,11 @@ void StorageDebugger::enableSQLDebugging( bool enable )
   mEnabled = enable;
 }
 
+QVariantMap StorageDebugger::queryCacheStatistics() const
+{
+  return QueryCache::statistics();
+}
+
 void StorageDebugger::queryExecuted( const QSqlQuery &query, int duration )
 {
   const qint64 seq = mSequence.fetchAndAddOrdered(1);
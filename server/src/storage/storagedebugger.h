@@ -53,6 +53,12 @@ class StorageDebugger : public QObject
 
     void incSequence() { mSequence.ref(); }
 
+    /**
+     * Returns the statistics of the prepared query caches of all threads.
+     * @see QueryCache::statistics()
+     */
+    QVariantMap queryCacheStatistics() const;
+
   Q_SIGNALS:
     void queryExecuted( double sequence, uint duration, const QString &query,
                         const QMap<QString,QVariant> &values,
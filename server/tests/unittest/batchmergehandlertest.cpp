@@ -0,0 +1,258 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QSettings>
+
+#include <handler/batchmerge.h>
+#include <imapstreamparser.h>
+#include <response.h>
+#include <storage/parttypehelper.h>
+
+#include <libs/notificationmessagev3_p.h>
+
+#include "fakeakonadiserver.h"
+#include "aktest.h"
+#include <akstandarddirs.h>
+
+#include <QtTest/QTest>
+#include <QSignalSpy>
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+class BatchMergeHandlerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    BatchMergeHandlerTest()
+    {
+        qRegisterMetaType<Akonadi::Server::Response>();
+
+        // Effectively disable external payload parts, we have a dedicated unit-test
+        // for that
+        const QString serverConfigFile = AkStandardDirs::serverConfigFile(XdgBaseDirs::ReadWrite);
+        QSettings settings(serverConfigFile, QSettings::IniFormat);
+        settings.setValue(QLatin1String("General/SizeThreshold"), std::numeric_limits<qint64>::max());
+
+        try {
+            FakeAkonadiServer::instance()->init();
+        } catch (FakeAkonadiServerException &e) {
+            akError() << e.what();
+            akFatal() << "Fake Akonadi Server failed to start up, aborting test";
+        }
+    }
+
+    ~BatchMergeHandlerTest()
+    {
+        FakeAkonadiServer::instance()->quit();
+    }
+
+    // @p flagsAndTags are appended to the attribute list as they are
+    QByteArray itemSpec(const QByteArray &remoteId, const QByteArray &remoteRevision,
+                        const QByteArray &data, const QByteArray &flagsAndTags = QByteArray())
+    {
+        return "4 " + QByteArray::number(data.size()) + " "
+               + "(\\RemoteId[" + remoteId + "] "
+               +  "\\MimeType[application/octet-stream] "
+               +  "\\RemoteRevision[" + remoteRevision + "] "
+               +  "\\Gid[" + remoteId + "]"
+               + (flagsAndTags.isEmpty() ? QByteArray() : " " + flagsAndTags) + ") "
+               + "\"12-May-2014 14:46:00 +0000\" (PLD:DATA[0] {" + QByteArray::number(data.size()) + "}";
+    }
+
+    QByteArray uidNext(qint64 uid)
+    {
+        return "S: 2 [UIDNEXT " + QByteArray::number(uid) + " DATETIME \"12-May-2014 14:46:00 +0000\"]";
+    }
+
+private Q_SLOTS:
+    void testBatchMerge_data()
+    {
+        QTest::addColumn<QList<QByteArray> >("scenario");
+        QTest::addColumn<int>("notifications");
+        QTest::addColumn<QVector<qint64> >("uids");
+        QTest::addColumn<QStringList>("remoteRevisions");
+        QTest::addColumn<QList<QByteArray> >("payloads");
+
+        QList<QByteArray> scenario;
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKBATCHMERGE (RID) " + itemSpec("TEST-1", "1", "0123456789")
+                 << "S: + Ready for literal data (expecting 10 bytes)"
+                 << "C: 0123456789) " + itemSpec("TEST-2", "1", "Random Data")
+                 << "S: + Ready for literal data (expecting 11 bytes)"
+                 << "C: Random Data)"
+                 << uidNext(13)
+                 << uidNext(14)
+                 << "S: 2 OK Batch merge completed";
+        QTest::newRow("append") << scenario << 2
+                                << (QVector<qint64>() << 13 << 14)
+                                << (QStringList() << QLatin1String("1") << QLatin1String("1"))
+                                << (QList<QByteArray>() << "0123456789" << "Random Data");
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKBATCHMERGE (RID SILENT) " + itemSpec("TEST-1", "2", "9876543210")
+                 << "S: + Ready for literal data (expecting 10 bytes)"
+                 << "C: 9876543210) " + itemSpec("TEST-3", "1", "12345")
+                 << "S: + Ready for literal data (expecting 5 bytes)"
+                 << "C: 12345)"
+                 << uidNext(13)
+                 << uidNext(15)
+                 << "S: 2 OK Batch merge completed";
+        QTest::newRow("merge and append") << scenario << 2
+                                          << (QVector<qint64>() << 13 << 15)
+                                          << (QStringList() << QLatin1String("2") << QLatin1String("1"))
+                                          << (QList<QByteArray>() << "9876543210" << "12345");
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKBATCHMERGE (RID) 100 0 () ()"
+                 << "S: 2 NO Unknown collection for '100'.";
+        QTest::newRow("invalid collection") << scenario << 0
+                                            << QVector<qint64>() << QStringList() << QList<QByteArray>();
+    }
+
+    void testBatchMerge()
+    {
+        QFETCH(QList<QByteArray>, scenario);
+        QFETCH(int, notifications);
+        QFETCH(QVector<qint64>, uids);
+        QFETCH(QStringList, remoteRevisions);
+        QFETCH(QList<QByteArray>, payloads);
+
+        FakeAkonadiServer::instance()->setScenario(scenario);
+        FakeAkonadiServer::instance()->runTest();
+
+        // All changes are announced in a single batch
+        QSignalSpy *notificationSpy = FakeAkonadiServer::instance()->notificationSpy();
+        if (notifications > 0) {
+            QCOMPARE(notificationSpy->count(), 1);
+            const NotificationMessageV3::List ntfs = notificationSpy->at(0).first().value<NotificationMessageV3::List>();
+            QCOMPARE(ntfs.count(), notifications);
+        } else {
+            QVERIFY(notificationSpy->isEmpty());
+        }
+
+        for (int i = 0; i < uids.count(); ++i) {
+            const PimItem item = PimItem::retrieveById(uids[i]);
+            QVERIFY(item.isValid());
+            QCOMPARE(item.collectionId(), 4ll);
+            QCOMPARE(item.remoteRevision(), remoteRevisions[i]);
+
+            const QVector<Part> parts = item.parts();
+            QCOMPARE(parts.count(), 1);
+            QCOMPARE(PartTypeHelper::fullName(parts.first().partType()), QLatin1String("PLD:DATA"));
+            QCOMPARE(parts.first().data(), payloads[i]);
+        }
+    }
+
+    void testBatchMergeFlagsAndTags_data()
+    {
+        QTest::addColumn<QList<QByteArray> >("scenario");
+        QTest::addColumn<QVector<qint64> >("uids");
+        QTest::addColumn<QStringList>("flags");
+        QTest::addColumn<QStringList>("tags");
+
+        QList<QByteArray> scenario;
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKBATCHMERGE (RID) " + itemSpec("TEST-4", "1", "abc", "\\SEEN \\Tag[TAG-1]")
+                 << "S: + Ready for literal data (expecting 3 bytes)"
+                 << "C: abc) " + itemSpec("TEST-5", "1", "def", "\\SEEN \\Tag[TAG-1]")
+                 << "S: + Ready for literal data (expecting 3 bytes)"
+                 << "C: def) " + itemSpec("TEST-6", "1", "ghi", "$FLAG")
+                 << "S: + Ready for literal data (expecting 3 bytes)"
+                 << "C: ghi)"
+                 << uidNext(16)
+                 << uidNext(17)
+                 << uidNext(18)
+                 << "S: 2 OK Batch merge completed";
+        QTest::newRow("append") << scenario
+                                << (QVector<qint64>() << 16 << 17 << 18)
+                                << (QStringList() << QLatin1String("\\SEEN") << QLatin1String("\\SEEN") << QLatin1String("$FLAG"))
+                                << (QStringList() << QLatin1String("TAG-1") << QLatin1String("TAG-1") << QString());
+
+        // The second item is merged into the first one, whose flags and tags
+        // must not be stored a second time
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKBATCHMERGE (RID SILENT) " + itemSpec("TEST-7", "1", "jkl", "\\SEEN \\Tag[TAG-1]")
+                 << "S: + Ready for literal data (expecting 3 bytes)"
+                 << "C: jkl) " + itemSpec("TEST-7", "2", "mno", "\\SEEN \\FLAGGED \\Tag[TAG-1]")
+                 << "S: + Ready for literal data (expecting 3 bytes)"
+                 << "C: mno)"
+                 << uidNext(19)
+                 << uidNext(19)
+                 << "S: 2 OK Batch merge completed";
+        QTest::newRow("merge into appended item") << scenario
+                                                  << (QVector<qint64>() << 19)
+                                                  << (QStringList() << QLatin1String("\\FLAGGED \\SEEN"))
+                                                  << (QStringList() << QLatin1String("TAG-1"));
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKBATCHMERGE (RID) " + itemSpec("TEST-6", "2", "abcde", "\\SEEN")
+                 << "S: + Ready for literal data (expecting 5 bytes)"
+                 << "C: abcde)"
+                 << uidNext(18)
+                 << "S: * 18 FETCH (UID 18 REV 0 REMOTEID \"TEST-6\" MIMETYPE \"application/octet-stream\" COLLECTIONID 4 SIZE 5 "
+                    "DATETIME \"12-May-2014 14:46:00 +0000\" REMOTEREVISION \"2\" GID \"TEST-6\" FLAGS (\\SEEN) "
+                    "ANCESTORS ((4 \"ColC\")) PLD:DATA {5}\r\nabcde)"
+                 << "S: 2 OK Batch merge completed";
+        QTest::newRow("merge with response") << scenario
+                                             << (QVector<qint64>() << 18)
+                                             << (QStringList() << QLatin1String("\\SEEN"))
+                                             << (QStringList() << QString());
+    }
+
+    void testBatchMergeFlagsAndTags()
+    {
+        QFETCH(QList<QByteArray>, scenario);
+        QFETCH(QVector<qint64>, uids);
+        QFETCH(QStringList, flags);
+        QFETCH(QStringList, tags);
+
+        FakeAkonadiServer::instance()->setScenario(scenario);
+        FakeAkonadiServer::instance()->runTest();
+
+        for (int i = 0; i < uids.count(); ++i) {
+            const PimItem item = PimItem::retrieveById(uids[i]);
+            QVERIFY(item.isValid());
+
+            QStringList flagNames;
+            Q_FOREACH (const Flag &flag, item.flags()) {
+                flagNames << flag.name();
+            }
+            flagNames.sort();
+            QCOMPARE(flagNames.join(QLatin1String(" ")), flags[i]);
+
+            QStringList tagGids;
+            Q_FOREACH (const Tag &tag, item.tags()) {
+                tagGids << tag.gid();
+            }
+            tagGids.sort();
+            QCOMPARE(tagGids.join(QLatin1String(" ")), tags[i]);
+        }
+    }
+};
+
+AKTEST_FAKESERVER_MAIN(BatchMergeHandlerTest)
+
+#include "batchmergehandlertest.moc"
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QSettings>
+
+#include <commandthrottle.h>
+#include <storage/datastore.h>
+
+#include "fakeakonadiserver.h"
+#include "aktest.h"
+#include "akdebug.h"
+#include <akstandarddirs.h>
+
+#include <QtTest/QTest>
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+class CommandThrottleTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    CommandThrottleTest()
+    {
+        const QString serverConfigFile = AkStandardDirs::serverConfigFile(XdgBaseDirs::ReadWrite);
+        QSettings settings(serverConfigFile, QSettings::IniFormat);
+        settings.setValue(QLatin1String("Connection/MaxConcurrentCommands"), 1);
+        settings.sync();
+
+        try {
+            FakeAkonadiServer::instance()->setPopulateDb(false);
+            FakeAkonadiServer::instance()->init();
+        } catch (const FakeAkonadiServerException &e) {
+            akError() << "Server exception: " << e.what();
+            akFatal() << "Fake Akonadi Server failed to start up, aborting test";
+        }
+    }
+
+    ~CommandThrottleTest()
+    {
+        FakeAkonadiServer::instance()->quit();
+    }
+
+private Q_SLOTS:
+    void testSlot()
+    {
+        QCOMPARE(CommandThrottle::maximumConcurrentCommands(), 1);
+        QCOMPARE(CommandThrottle::availableSlots(), 1);
+        {
+            CommandThrottle::Slot slot;
+            QCOMPARE(CommandThrottle::availableSlots(), 0);
+            {
+                // the thread already holds the slot
+                CommandThrottle::Slot nested;
+                QCOMPARE(CommandThrottle::availableSlots(), 0);
+            }
+            QCOMPARE(CommandThrottle::availableSlots(), 0);
+        }
+        QCOMPARE(CommandThrottle::availableSlots(), 1);
+    }
+
+    void testSuspend()
+    {
+        {
+            CommandThrottle::Slot slot;
+            {
+                CommandThrottle::Suspender suspender;
+                QCOMPARE(CommandThrottle::availableSlots(), 1);
+            }
+            QCOMPARE(CommandThrottle::availableSlots(), 0);
+        }
+        QCOMPARE(CommandThrottle::availableSlots(), 1);
+    }
+
+    void testSuspendInTransaction()
+    {
+        DataStore *store = DataStore::self();
+        {
+            CommandThrottle::Slot slot;
+            QCOMPARE(CommandThrottle::availableSlots(), 0);
+
+            QVERIFY(store->beginTransaction());
+            {
+                CommandThrottle::Suspender suspender;
+                QCOMPARE(CommandThrottle::availableSlots(), 1);
+            }
+            // the slot is not taken back within the transaction
+            QCOMPARE(CommandThrottle::availableSlots(), 1);
+            QVERIFY(store->commitTransaction());
+        }
+        QCOMPARE(CommandThrottle::availableSlots(), 1);
+
+        // slots are not taken within a transaction at all
+        QVERIFY(store->beginTransaction());
+        {
+            CommandThrottle::Slot slot;
+            QCOMPARE(CommandThrottle::availableSlots(), 1);
+            {
+                CommandThrottle::Suspender suspender;
+                QCOMPARE(CommandThrottle::availableSlots(), 1);
+            }
+            QCOMPARE(CommandThrottle::availableSlots(), 1);
+        }
+        QVERIFY(store->commitTransaction());
+        QCOMPARE(CommandThrottle::availableSlots(), 1);
+    }
+};
+
+AKTEST_FAKESERVER_MAIN(CommandThrottleTest)
+
+#include "commandthrottletest.moc"
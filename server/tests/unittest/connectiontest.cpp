@@ -0,0 +1,157 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTemporaryFile>
+
+#include <connection.h>
+#include <response.h>
+
+#include <aktest.h>
+
+#include <QtTest/QTest>
+
+using namespace Akonadi::Server;
+
+class TestConnection : public Connection
+{
+public:
+    TestConnection(quintptr socketDescriptor)
+        : Connection(socketDescriptor)
+    {
+    }
+
+    void send(const Response &response)
+    {
+        slotResponseAvailable(response);
+    }
+};
+
+class TestServer : public QLocalServer
+{
+public:
+    TestServer()
+        : QLocalServer()
+        , descriptor(0)
+    {
+    }
+
+    quintptr descriptor;
+
+protected:
+    void incomingConnection(quintptr socketDescriptor)
+    {
+        descriptor = socketDescriptor;
+    }
+};
+
+class ConnectionTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Sends @p response through a Connection and returns what the client received
+    // from the start of the response up to the final CRLF
+    QByteArray roundTrip(const Response &response)
+    {
+        const QString socketName = QDir::tempPath() + QLatin1String("/akonadi-connectiontest-") + QString::number(QCoreApplication::applicationPid());
+        QLocalServer::removeServer(socketName);
+        TestServer server;
+        if (!server.listen(socketName)) {
+            return QByteArray();
+        }
+
+        QLocalSocket client;
+        client.connectToServer(socketName);
+        if (!client.waitForConnected(5000) || !server.waitForNewConnection(5000) || server.descriptor == 0) {
+            return QByteArray();
+        }
+
+        TestConnection connection(server.descriptor);
+        connection.send(response);
+
+        const QByteArray start = response.asString().left(8);
+        QByteArray received;
+        while (!received.endsWith(")\r\n") && client.waitForReadyRead(5000)) {
+            received += client.readAll();
+        }
+        // skip the greeting in case it made it out already
+        return received.mid(received.indexOf(start));
+    }
+
+private Q_SLOTS:
+    void testStreamFileLiteral_data()
+    {
+        QTest::addColumn<QByteArray>("content");
+        QTest::addColumn<qint64>("literalSize");
+        QTest::addColumn<QByteArray>("expected");
+
+        const QByteArray data(48 * 1024, 'x');
+        QTest::newRow("complete file") << data << qint64(data.size()) << data;
+        QTest::newRow("empty file") << QByteArray() << qint64(0) << QByteArray();
+        // the file got shorter after the literal size has been announced
+        QTest::newRow("short file") << QByteArray("0123456789") << qint64(15)
+                                    << QByteArray("0123456789     ");
+    }
+
+    void testStreamFileLiteral()
+    {
+        QFETCH(QByteArray, content);
+        QFETCH(qint64, literalSize);
+        QFETCH(QByteArray, expected);
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QCOMPARE(file.write(content), qint64(content.size()));
+        file.flush();
+
+        Response response;
+        response.setUntagged();
+        response.setString("1 FETCH (PLD:DATA ");
+        response.appendFileLiteral(file.fileName(), literalSize);
+        response.appendString(")");
+
+        const QByteArray received = roundTrip(response);
+        const QByteArray header = "* 1 FETCH (PLD:DATA {" + QByteArray::number(literalSize) + "}\r\n";
+        QCOMPARE(received, header + expected + ")\r\n");
+    }
+
+    void testMissingFileLiteral()
+    {
+        Response response;
+        response.setUntagged();
+        response.setString("1 FETCH (PLD:DATA ");
+        response.appendFileLiteral(QLatin1String("/nonexistent/akonadi/payload"), 5);
+        response.appendString(")");
+
+        // the announced literal is completed with padding
+        QCOMPARE(roundTrip(response), QByteArray("* 1 FETCH (PLD:DATA {5}\r\n     )\r\n"));
+        // tracing does not read the file
+        QCOMPARE(response.asString(), QByteArray("* 1 FETCH (PLD:DATA {5}\r\n[5 bytes from /nonexistent/akonadi/payload])"));
+    }
+};
+
+AKTEST_MAIN(ConnectionTest)
+
+#include "connectiontest.moc"
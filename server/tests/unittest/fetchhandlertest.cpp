@@ -0,0 +1,226 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QSettings>
+
+#include <handler/fetch.h>
+#include <handler/scope.h>
+#include <imapstreamparser.h>
+#include <response.h>
+
+#include "fakeakonadiserver.h"
+#include "aktest.h"
+#include "akdebug.h"
+#include <akstandarddirs.h>
+
+#include <QtTest/QTest>
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+class FetchHandlerTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    FetchHandlerTest()
+    {
+        qRegisterMetaType<Akonadi::Server::Response>();
+
+        // Keep the payload in the database, so it is sent inline
+        const QString serverConfigFile = AkStandardDirs::serverConfigFile(XdgBaseDirs::ReadWrite);
+        QSettings settings(serverConfigFile, QSettings::IniFormat);
+        settings.setValue(QLatin1String("General/SizeThreshold"), std::numeric_limits<qint64>::max());
+
+        try {
+            FakeAkonadiServer::instance()->init();
+        } catch (const FakeAkonadiServerException &e) {
+            akError() << "Server exception: " << e.what();
+            akFatal() << "Fake Akonadi Server failed to start up, aborting test";
+        }
+    }
+
+    ~FetchHandlerTest()
+    {
+        FakeAkonadiServer::instance()->quit();
+    }
+
+    // Appends an item with @p payload to Collection C, which gets @p uid assigned
+    QList<QByteArray> appendScenario(qint64 uid, const QByteArray &payload)
+    {
+        const QByteArray size = QByteArray::number(payload.size());
+        QList<QByteArray> scenario;
+        scenario << "C: 2 X-AKAPPEND 4 " + size + " (\\RemoteId[ITEM-" + QByteArray::number(uid) + "] "
+                                                + "\\MimeType[application/octet-stream]) "
+                                                + "\"12-May-2014 14:46:00 +0000\" (PLD:DATA {" + size + "}"
+                 << "S: + Ready for literal data (expecting " + size + " bytes)"
+                 << "C: " + payload + ")"
+                 << "S: 2 [UIDNEXT " + QByteArray::number(uid) + " DATETIME \"12-May-2014 14:46:00 +0000\"]"
+                 << "S: 2 OK Append completed";
+        return scenario;
+    }
+
+    // Mirrors FetchHelper::scopeHash() for a UID scope without context
+    QByteArray continuationToken(qint64 lastId, const QByteArray &uidSet)
+    {
+        const QByteArray scope = QByteArray::number(Scope::Uid) + ' ' + uidSet + "    -1 -1 -1 ";
+        return QByteArray::number(lastId) + ':' + QByteArray::number(qHash(scope), 16);
+    }
+
+    QByteArray itemResponse(qint64 id)
+    {
+        return "S: * " + QByteArray::number(id) + " FETCH (UID " + QByteArray::number(id)
+                + " REV 0 MIMETYPE \"application/octet-stream\" COLLECTIONID 3)";
+    }
+
+private Q_SLOTS:
+    void testFetchPayload_data()
+    {
+        QTest::addColumn<QList<QByteArray> >("scenario");
+
+        QByteArray payload = "0123456789";
+        QList<QByteArray> scenario;
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << appendScenario(13, payload)
+                 << "C: 3 UID FETCH 13 CACHEONLY (PLD:DATA)"
+                 << "S: * 13 FETCH (UID 13 REV 0 MIMETYPE \"application/octet-stream\" COLLECTIONID 4 PLD:DATA {10}\r\n" + payload + ")"
+                 << "S: 3 OK UID FETCH completed";
+        QTest::newRow("small part") << scenario;
+
+        // Parts of 64 kB and more are sent in fragments, which must not be
+        // visible to the client
+        payload.clear();
+        for (int i = 0; i < 100 * 1024; ++i) {
+            payload += char('a' + i % 26);
+        }
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << appendScenario(14, payload)
+                 << "C: 3 UID FETCH 14 CACHEONLY (PLD:DATA)"
+                 << "S: * 14 FETCH (UID 14 REV 0 MIMETYPE \"application/octet-stream\" COLLECTIONID 4 PLD:DATA {102400}\r\n" + payload + ")"
+                 << "S: 3 OK UID FETCH completed";
+        QTest::newRow("large part") << scenario;
+    }
+
+    void testFetchPayload()
+    {
+        QFETCH(QList<QByteArray>, scenario);
+
+        FakeAkonadiServer::instance()->setScenario(scenario);
+        FakeAkonadiServer::instance()->runTest();
+    }
+
+    void testFetchIgnoreErrors_data()
+    {
+        QTest::addColumn<QList<QByteArray> >("scenario");
+
+        QByteArray payload;
+        for (int i = 0; i < 100 * 1024; ++i) {
+            payload += char('a' + i % 26);
+        }
+
+        // The large part comes before the empty one, no fragment of the
+        // skipped item may reach the client
+        QList<QByteArray> scenario;
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 X-AKAPPEND 4 102400 (\\RemoteId[ITEM-15] \\MimeType[application/octet-stream]) "
+                    "\"12-May-2014 14:46:00 +0000\" (PLD:DATA {102400}"
+                 << "S: + Ready for literal data (expecting 102400 bytes)"
+                 << "C: " + payload + " PLD:HEAD \"\")"
+                 << "S: 2 [UIDNEXT 15 DATETIME \"12-May-2014 14:46:00 +0000\"]"
+                 << "S: 2 OK Append completed"
+                 << "C: 3 UID FETCH 13,15 CACHEONLY IGNOREERRORS (PLD:DATA PLD:HEAD)"
+                 << "S: * 13 FETCH (UID 13 REV 0 MIMETYPE \"application/octet-stream\" COLLECTIONID 4 PLD:DATA {10}\r\n0123456789)"
+                 << "S: 3 OK UID FETCH completed";
+        QTest::newRow("large part before empty part") << scenario;
+    }
+
+    void testFetchIgnoreErrors()
+    {
+        QFETCH(QList<QByteArray>, scenario);
+
+        FakeAkonadiServer::instance()->setScenario(scenario);
+        FakeAkonadiServer::instance()->runTest();
+    }
+
+    void testFetchPage_data()
+    {
+        QTest::addColumn<QList<QByteArray> >("scenario");
+
+        QList<QByteArray> scenario;
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 UID FETCH 1:12 LIMIT 5 ()"
+                 << itemResponse(12) << itemResponse(11) << itemResponse(10) << itemResponse(9) << itemResponse(8)
+                 << "S: * CONTINUE " + continuationToken(8, "1:12")
+                 << "S: 2 OK UID FETCH completed"
+                 << "C: 3 UID FETCH 1:12 LIMIT 5 CONTINUE \"" + continuationToken(8, "1:12") + "\" ()"
+                 << itemResponse(7) << itemResponse(6) << itemResponse(5) << itemResponse(4) << itemResponse(3)
+                 << "S: * CONTINUE " + continuationToken(3, "1:12")
+                 << "S: 3 OK UID FETCH completed"
+                 << "C: 4 UID FETCH 1:12 LIMIT 5 CONTINUE \"" + continuationToken(3, "1:12") + "\" ()"
+                 << itemResponse(2) << itemResponse(1)
+                 << "S: 4 OK UID FETCH completed";
+        QTest::newRow("partial last page") << scenario;
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 UID FETCH 1:4 LIMIT 2 ()"
+                 << itemResponse(4) << itemResponse(3)
+                 << "S: * CONTINUE " + continuationToken(3, "1:4")
+                 << "S: 2 OK UID FETCH completed"
+                 << "C: 3 UID FETCH 1:4 LIMIT 2 CONTINUE \"" + continuationToken(3, "1:4") + "\" ()"
+                 << itemResponse(2) << itemResponse(1)
+                 << "S: * CONTINUE " + continuationToken(1, "1:4")
+                 << "S: 3 OK UID FETCH completed"
+                 << "C: 4 UID FETCH 1:4 LIMIT 2 CONTINUE \"" + continuationToken(1, "1:4") + "\" ()"
+                 << "S: 4 OK UID FETCH completed";
+        QTest::newRow("full last page") << scenario;
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 UID FETCH 1:5 LIMIT 2 CONTINUE \"" + continuationToken(3, "1:4") + "\" ()"
+                 << "S: 2 NO Invalid continuation token";
+        QTest::newRow("token of other scope") << scenario;
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 UID FETCH 1:4 CONTINUE \"" + continuationToken(3, "1:4") + "\" ()"
+                 << "S: 2 NO CONTINUE requires LIMIT";
+        QTest::newRow("continue without limit") << scenario;
+
+        scenario.clear();
+        scenario << FakeAkonadiServer::defaultScenario()
+                 << "C: 2 UID FETCH 1:4 LIMIT 0 ()"
+                 << "S: 2 NO Invalid LIMIT";
+        QTest::newRow("zero limit") << scenario;
+    }
+
+    void testFetchPage()
+    {
+        QFETCH(QList<QByteArray>, scenario);
+
+        FakeAkonadiServer::instance()->setScenario(scenario);
+        FakeAkonadiServer::instance()->runTest();
+    }
+};
+
+AKTEST_FAKESERVER_MAIN(FetchHandlerTest)
+
+#include "fetchhandlertest.moc"
@@ -125,6 +125,65 @@ class FetchScopeTest : public QObject
       QCOMPARE( fs.remoteIdRequested(), remoteIdRequested );
       QCOMPARE( fs.gidRequested(), gidRequested );
     }
+
+    void testPagingParsing()
+    {
+      QByteArray ba( "LIMIT 100 CONTINUE 4711:1a2b3c (REMOTEID)\n" );
+      QBuffer buffer( &ba, this );
+      buffer.open( QIODevice::ReadOnly );
+      ImapStreamParser parser( &buffer );
+
+      const FetchScope fs( &parser );
+      QCOMPARE( fs.limit(), 100 );
+      QCOMPARE( fs.continuationToken(), QByteArray( "4711:1a2b3c" ) );
+      QVERIFY( fs.remoteIdRequested() );
+
+      const FetchScope defaultScope;
+      QCOMPARE( defaultScope.limit(), 0 );
+      QVERIFY( defaultScope.continuationToken().isEmpty() );
+    }
+
+    void testInvalidPagingParsing_data()
+    {
+      QTest::addColumn<QByteArray>( "input" );
+
+      QTest::newRow( "zero limit" ) << QByteArray( "LIMIT 0 (REMOTEID)\n" );
+      QTest::newRow( "negative limit" ) << QByteArray( "LIMIT -1 (REMOTEID)\n" );
+      QTest::newRow( "limit out of range" ) << QByteArray( "LIMIT 2147483648 (REMOTEID)\n" );
+      QTest::newRow( "continue without limit" ) << QByteArray( "CONTINUE 4711:1a2b3c (REMOTEID)\n" );
+    }
+
+    void testInvalidPagingParsing()
+    {
+      QFETCH( QByteArray, input );
+
+      QBuffer buffer( &input, this );
+      buffer.open( QIODevice::ReadOnly );
+      ImapStreamParser parser( &buffer );
+
+      bool thrown = false;
+      try {
+        const FetchScope fs( &parser );
+      } catch ( const HandlerException & ) {
+        thrown = true;
+      }
+      QVERIFY( thrown );
+    }
+
+    void testBackgroundParsing()
+    {
+      QByteArray ba( "BACKGROUND IGNOREERRORS (PLD:RFC822)\n" );
+      QBuffer buffer( &ba, this );
+      buffer.open( QIODevice::ReadOnly );
+      ImapStreamParser parser( &buffer );
+
+      const FetchScope fs( &parser );
+      QVERIFY( fs.background() );
+      QVERIFY( fs.ignoreErrors() );
+      QCOMPARE( fs.requestedPayloads(), QStringList() << QLatin1String( "PLD:RFC822" ) );
+
+      QVERIFY( !FetchScope().background() );
+    }
 };
 
 QTEST_MAIN( FetchScopeTest )
@@ -46,6 +46,9 @@ class HandlerHelperTest : public QObject
       c.setCachePolicyLocalParts( QLatin1String( "PART1 PART2" ) );
       c.setCachePolicySyncOnDemand( true );
       QTest::newRow( "non-inherit" ) << c << QByteArray( "CACHEPOLICY (INHERIT false INTERVAL 1 CACHETIMEOUT 2 SYNCONDEMAND true LOCALPARTS (PART1 PART2))" );
+
+      c.setCachePolicyPrefetch( 5 );
+      QTest::newRow( "prefetch" ) << c << QByteArray( "CACHEPOLICY (INHERIT false INTERVAL 1 CACHETIMEOUT 2 SYNCONDEMAND true LOCALPARTS (PART1 PART2) PREFETCH 5)" );
     }
 
     void testCachePolicyToByteArray()
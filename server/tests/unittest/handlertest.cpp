@@ -57,6 +57,7 @@ class HandlerTest : public QObject
       MAKE_CMD_ROW( ROLLBACK, TransactionHandler )
       MAKE_CMD_ROW( COMMIT, TransactionHandler )
       MAKE_CMD_ROW( X-AKAPPEND, AkAppend )
+      MAKE_CMD_ROW( X-AKBATCHMERGE, BatchMerge )
       MAKE_CMD_ROW( SUBSCRIBE, Subscribe )
       MAKE_CMD_ROW( UNSUBSCRIBE, Subscribe )
       MAKE_CMD_ROW( COPY, Copy )
@@ -67,6 +68,14 @@ class HandlerTest : public QObject
       MAKE_CMD_ROW( REMOVE, Remove )
       MAKE_CMD_ROW( MOVE, Move )
       MAKE_CMD_ROW( COLMOVE, ColMove )
+      MAKE_CMD_ROW( SEARCH_RESULT, SearchResult )
+      MAKE_CMD_ROW( TAGAPPEND, TagAppend )
+      MAKE_CMD_ROW( TAGFETCH, TagFetch )
+      MAKE_CMD_ROW( TAGREMOVE, TagRemove )
+      MAKE_CMD_ROW( TAGSTORE, TagStore )
+      MAKE_CMD_ROW( MERGE, Merge )
+      MAKE_CMD_ROW( X-AKLIST, List )
+      MAKE_CMD_ROW( X-AKLSUB, List )
     }
 
     void addNonAuthCommands()
@@ -83,6 +92,9 @@ class HandlerTest : public QObject
     void addInvalidCommands()
     {
       MAKE_CMD_ROW( UNKNOWN, UnknownCommandHandler )
+      MAKE_CMD_ROW( A, UnknownCommandHandler )
+      MAKE_CMD_ROW( ZZZ, UnknownCommandHandler )
+      MAKE_CMD_ROW( fetch, UnknownCommandHandler )
     }
   private Q_SLOTS:
     void testFindAuthenticatedCommand_data()
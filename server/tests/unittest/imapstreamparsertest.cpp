@@ -466,3 +466,72 @@ void ImapStreamParserTest::testAbortCommand()
     QFAIL( "Exception caught" );
   }
 }
+
+void ImapStreamParserTest::testReadLiteralPartView()
+{
+  QByteArray input( "1 X-AKAPPEND 2 10 () {10}\n0123456789 {3}\nabc\nNEXTCOMMAND " );
+  QBuffer buffer( &input, this );
+  buffer.open( QIODevice::ReadOnly );
+  ImapStreamParser parser( &buffer );
+
+  try {
+    QCOMPARE( parser.readString(), QByteArray( "1" ) );
+    QCOMPARE( parser.readString(), QByteArray( "X-AKAPPEND" ) );
+    QCOMPARE( parser.readNumber(), 2ll );
+    QCOMPARE( parser.readNumber(), 10ll );
+    QCOMPARE( parser.readParenthesizedList(), QList<QByteArray>() );
+    QVERIFY( parser.hasLiteral( false ) );
+    QByteArray data;
+    while ( !parser.atLiteralEnd() ) {
+      data += parser.readLiteralPartView();
+    }
+    QCOMPARE( data, QByteArray( "0123456789" ) );
+    QCOMPARE( parser.readString(), QByteArray( "abc" ) );
+    QVERIFY( parser.atCommandEnd() );
+    QCOMPARE( parser.readString(), QByteArray( "NEXTCOMMAND" ) );
+  } catch ( const Akonadi::Server::Exception &e ) {
+    qDebug() << e.type() << e.what();
+    QFAIL( "Exception caught" );
+  }
+}
+
+void ImapStreamParserTest::benchmarkReadLiteral_data()
+{
+  QTest::addColumn<int>( "size" );
+  QTest::addColumn<bool>( "zeroCopy" );
+
+  QTest::newRow( "64 kB, copy" ) << 64 * 1024 << false;
+  QTest::newRow( "64 kB, view" ) << 64 * 1024 << true;
+  QTest::newRow( "10 MB, copy" ) << 10 * 1024 * 1024 << false;
+  QTest::newRow( "10 MB, view" ) << 10 * 1024 * 1024 << true;
+}
+
+void ImapStreamParserTest::benchmarkReadLiteral()
+{
+  QFETCH( int, size );
+  QFETCH( bool, zeroCopy );
+
+  // a large X-AKAPPEND/MERGE stream, with the literal streamed the same way
+  // PartHelper::streamToFile() does
+  QByteArray input( "1 X-AKAPPEND 2 " + QByteArray::number( size ) + " () {" + QByteArray::number( size ) + "}\n" );
+  input += QByteArray( size, 'x' );
+  input += "\n";
+
+  QBENCHMARK {
+    QBuffer buffer( &input );
+    buffer.open( QIODevice::ReadOnly );
+    ImapStreamParser parser( &buffer );
+    parser.readString();
+    parser.readString();
+    parser.readNumber();
+    parser.readNumber();
+    parser.readParenthesizedList();
+    QVERIFY( parser.hasLiteral( false ) );
+    qint64 read = 0;
+    while ( !parser.atLiteralEnd() ) {
+      read += zeroCopy ? parser.readLiteralPartView().size() : parser.readLiteralPart().size();
+    }
+    QCOMPARE( read, qint64( size ) );
+    QVERIFY( parser.atCommandEnd() );
+  }
+}
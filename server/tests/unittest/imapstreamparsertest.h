@@ -40,6 +40,9 @@ class ImapStreamParserTest : public QObject
     void testReadUntilCommandEnd();
     void testReadUntilCommandEnd2();
     void testAbortCommand();
+    void testReadLiteralPartView();
+    void benchmarkReadLiteral_data();
+    void benchmarkReadLiteral();
 
 };
 
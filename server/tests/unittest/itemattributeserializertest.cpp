@@ -0,0 +1,190 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QtTest/QTest>
+#include <QtCore/QDateTime>
+#include <QtCore/QLocale>
+
+#include "handler/itemattributeserializer.h"
+#include "libs/imapparser_p.h"
+#include "libs/protocol_p.h"
+#include "utils.h"
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+enum TestColumns {
+  IdColumn,
+  RevColumn,
+  RidColumn,
+  MimeTypeColumn,
+  CollectionIdColumn,
+  SizeColumn,
+  DatetimeColumn,
+  RemoteRevisionColumn,
+  GidColumn
+};
+
+// stands in for the QSqlQuery the serializer reads from in FetchHelper
+struct TestRow
+{
+  QVariant value( int column ) const
+  {
+    return values.at( column );
+  }
+
+  QVector<QVariant> values;
+};
+
+class ItemAttributeSerializerTest : public QObject
+{
+  Q_OBJECT
+
+  private:
+    static TestRow createRow( qint64 id )
+    {
+      TestRow row;
+      row.values << id << 3 << QString::fromLatin1( "rid%1" ).arg( id )
+                 << QString::fromLatin1( "application/octet-stream" ) << 42LL << 1024LL
+                 << QDateTime( QDate( 2014, 4, 1 ), QTime( 12, 30 ), Qt::UTC )
+                 << ( id % 2 ? QString::fromLatin1( "rrev" ) : QString() )
+                 << QString::fromLatin1( "gid%1" ).arg( id );
+      return row;
+    }
+
+    static ItemAttributeSerializer createSerializer()
+    {
+      ItemAttributeSerializer serializer;
+      serializer.addColumn( AKONADI_PARAM_UID, IdColumn, ItemAttributeSerializer::NumberValue );
+      serializer.addColumn( AKONADI_PARAM_REVISION, RevColumn, ItemAttributeSerializer::NumberValue );
+      serializer.addColumn( AKONADI_PARAM_REMOTEID, RidColumn, ItemAttributeSerializer::StringValue );
+      serializer.addColumn( AKONADI_PARAM_MIMETYPE, MimeTypeColumn, ItemAttributeSerializer::StringValue );
+      serializer.addColumn( AKONADI_PARAM_COLLECTIONID, CollectionIdColumn, ItemAttributeSerializer::NumberValue );
+      serializer.addColumn( AKONADI_PARAM_SIZE, SizeColumn, ItemAttributeSerializer::NumberValue );
+      serializer.addColumn( AKONADI_PARAM_MTIME, DatetimeColumn, ItemAttributeSerializer::DateTimeValue );
+      serializer.addColumn( AKONADI_PARAM_REMOTEREVISION, RemoteRevisionColumn, ItemAttributeSerializer::OptionalStringValue );
+      serializer.addColumn( AKONADI_PARAM_GID, GidColumn, ItemAttributeSerializer::OptionalStringValue );
+      return serializer;
+    }
+
+    // a re-implementation of the attribute list based serialization FetchHelper
+    // used before, it stands in for the old code in the benchmark below
+    static QByteArray joinAttributes( const TestRow &row, bool remoteIdRequested, bool sizeRequested,
+                                      bool mTimeRequested, bool remoteRevisionRequested, bool gidRequested )
+    {
+      QList<QByteArray> attributes;
+      attributes.append( AKONADI_PARAM_UID " " + QByteArray::number( row.value( IdColumn ).toLongLong() ) );
+      attributes.append( AKONADI_PARAM_REVISION " " + QByteArray::number( row.value( RevColumn ).toInt() ) );
+      if ( remoteIdRequested ) {
+        attributes.append( AKONADI_PARAM_REMOTEID " " + ImapParser::quote( Utils::variantToByteArray( row.value( RidColumn ) ) ) );
+      }
+      attributes.append( AKONADI_PARAM_MIMETYPE " " + ImapParser::quote( Utils::variantToByteArray( row.value( MimeTypeColumn ) ) ) );
+      attributes.append( AKONADI_PARAM_COLLECTIONID " " + QByteArray::number( row.value( CollectionIdColumn ).toLongLong() ) );
+      if ( sizeRequested ) {
+        attributes.append( AKONADI_PARAM_SIZE " " + QByteArray::number( row.value( SizeColumn ).toLongLong() ) );
+      }
+      if ( mTimeRequested ) {
+        const QString datetime = QLocale::c().toString( row.value( DatetimeColumn ).toDateTime(), QLatin1String( "dd-MMM-yyyy hh:mm:ss +0000" ) );
+        attributes.append( AKONADI_PARAM_MTIME " " + ImapParser::quote( datetime.toUtf8() ) );
+      }
+      if ( remoteRevisionRequested ) {
+        const QByteArray rrev = Utils::variantToByteArray( row.value( RemoteRevisionColumn ) );
+        if ( !rrev.isEmpty() ) {
+          attributes.append( AKONADI_PARAM_REMOTEREVISION " " + ImapParser::quote( rrev ) );
+        }
+      }
+      if ( gidRequested ) {
+        const QByteArray gid = Utils::variantToByteArray( row.value( GidColumn ) );
+        if ( !gid.isEmpty() ) {
+          attributes.append( AKONADI_PARAM_GID " " + ImapParser::quote( gid ) );
+        }
+      }
+      return QByteArray::number( row.value( IdColumn ).toLongLong() ) + " FETCH (" + ImapParser::join( attributes, " " ) + ')';
+    }
+
+  private Q_SLOTS:
+    void testSerialize()
+    {
+      const ItemAttributeSerializer serializer = createSerializer();
+      QCOMPARE( serializer.columnCount(), 9 );
+
+      for ( qint64 id = 1; id <= 2; ++id ) {
+        const TestRow row = createRow( id );
+        QByteArray buffer = QByteArray::number( id ) + " FETCH (";
+        serializer.serialize( row, buffer );
+        buffer += ')';
+        QCOMPARE( buffer, joinAttributes( row, true, true, true, true, true ) );
+      }
+
+      QByteArray buffer;
+      serializer.serialize( createRow( 1 ), buffer );
+      QCOMPARE( buffer, QByteArray( "UID 1 REV 3 REMOTEID \"rid1\" MIMETYPE \"application/octet-stream\" COLLECTIONID 42 "
+                                    "SIZE 1024 DATETIME \"01-Apr-2014 12:30:00 +0000\" REMOTEREVISION \"rrev\" GID \"gid1\"" ) );
+
+      buffer.clear();
+      serializer.serialize( createRow( 2 ), buffer );
+      QVERIFY( !buffer.contains( AKONADI_PARAM_REMOTEREVISION ) );
+    }
+
+    // Compares the serializer with joinAttributes() on in-memory rows, neither
+    // the database query nor the rest of FetchHelper are part of the measurement
+    void benchmarkSerialize_data()
+    {
+      QTest::addColumn<bool>( "usePlan" );
+
+      QTest::newRow( "attribute list (stand-in)" ) << false;
+      QTest::newRow( "column plan" ) << true;
+    }
+
+    void benchmarkSerialize()
+    {
+      QFETCH( bool, usePlan );
+
+      QVector<TestRow> rows;
+      rows.reserve( 100000 );
+      for ( qint64 id = 0; id < 100000; ++id ) {
+        rows << createRow( id );
+      }
+
+      QBENCHMARK {
+        const ItemAttributeSerializer serializer = createSerializer();
+        qint64 size = 0;
+        for ( int i = 0; i < rows.size(); ++i ) {
+          const TestRow &row = rows.at( i );
+          if ( usePlan ) {
+            QByteArray buffer;
+            buffer.reserve( 512 );
+            buffer += QByteArray::number( row.value( IdColumn ).toLongLong() );
+            buffer += " FETCH (";
+            serializer.serialize( row, buffer );
+            buffer += ')';
+            size += buffer.size();
+          } else {
+            size += joinAttributes( row, true, true, true, true, true ).size();
+          }
+        }
+        QVERIFY( size > 0 );
+      }
+    }
+};
+
+QTEST_MAIN( ItemAttributeSerializerTest )
+
+#include "itemattributeserializertest.moc"
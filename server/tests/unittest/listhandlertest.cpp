@@ -156,6 +156,18 @@ private Q_SLOTS:
                     << "S: 2 OK List completed";
             QTest::newRow("recursive list of enabled") << scenario;
         }
+        {
+            QList<QByteArray> scenario;
+            // commands sent before the previous one completed are processed in order
+            scenario << FakeAkonadiServer::defaultScenario()
+                    << "C: 2 LIST 2 0 () ()"
+                    << "C: 3 LIST 2 1 () ()"
+                    << colAResponse
+                    << "S: 2 OK List completed"
+                    << colBResponse
+                    << "S: 3 OK List completed";
+            QTest::newRow("pipelined list") << scenario;
+        }
     }
 
     void testList()
@@ -154,6 +154,37 @@ void QueryBuilderTest::testQueryBuilder_data()
   mBuilders << qb;
   QTest::newRow( "insert multi column PSQL without id" ) << mBuilders.count() << QString( "INSERT INTO table (col1, col2) VALUES (:0, :1)" ) << bindVals;
 
+  qb = QueryBuilder( "table", QueryBuilder::Insert );
+  qb.setDatabaseType( DbType::MySQL );
+  qb.setBulkInsert( true );
+  qb.setColumnValue( "col1", QVariantList() << 1 << 2 );
+  qb.setColumnValue( "col2", QVariantList() << QString( "a" ) << QString( "b" ) );
+  mBuilders << qb;
+  bindVals.clear();
+  bindVals << 1 << QString( "a" ) << 2 << QString( "b" );
+  QTest::newRow( "bulk insert" ) << mBuilders.count() << QString( "INSERT INTO table (col1, col2) VALUES (:0, :1), (:2, :3)" ) << bindVals;
+
+  qb = QueryBuilder( "table", QueryBuilder::Insert );
+  qb.setDatabaseType( DbType::PostgreSQL );
+  qb.setBulkInsert( true );
+  qb.setColumnValue( "col1", QVariantList() << 1 << 2 << 3 );
+  mBuilders << qb;
+  bindVals.clear();
+  bindVals << 1 << 2 << 3;
+  QTest::newRow( "bulk insert PSQL split" ) << mBuilders.count()
+      << QString( "INSERT INTO table (col1) VALUES (:0), (:1); INSERT INTO table (col1) VALUES (:0)" ) << bindVals;
+
+  qb = QueryBuilder( "table", QueryBuilder::Insert );
+  qb.setDatabaseType( DbType::Sqlite );
+  qb.setBulkInsert( true );
+  qb.setColumnValue( "col1", QVariantList() << 1 << 2 );
+  qb.setColumnValue( "col2", QVariantList() << QString( "a" ) << QString( "b" ) );
+  mBuilders << qb;
+  bindVals.clear();
+  bindVals << 1 << QString( "a" ) << 2 << QString( "b" );
+  QTest::newRow( "bulk insert SQLite" ) << mBuilders.count()
+      << QString( "INSERT INTO table (col1, col2) SELECT :0, :1 UNION ALL SELECT :2, :3" ) << bindVals;
+
   // test GROUP BY foo
   bindVals.clear();
   qb = QueryBuilder( "table", QueryBuilder::Select );
@@ -311,6 +342,71 @@ void QueryBuilderTest::testQueryBuilder()
   QCOMPARE( mBuilders[qbId].mBindValues, bindValues );
 }
 
+void QueryBuilderTest::testShapeFingerprint()
+{
+  // the bind values must match those of the generated statement
+  for ( int i = 0; i < mBuilders.count(); ++i ) {
+    QueryBuilder qb = mBuilders.at( i );
+    if ( qb.shapeFingerprint() == 0 ) {
+      continue;
+    }
+    qb.mBindValues.clear();
+    QString statement;
+    qb.buildQuery( &statement );
+    const QVector<QVariant> bindValues = qb.mBindValues;
+    qb.mBindValues.clear();
+    qb.collectBindValues();
+    QCOMPARE( qb.mBindValues, bindValues );
+  }
+
+  QueryBuilder qb( "table", QueryBuilder::Select );
+  qb.addColumn( "col1" );
+  qb.addValueCondition( "col1", Query::Equals, 5 );
+  const quint64 shape = qb.shapeFingerprint();
+  QVERIFY( shape != 0 );
+
+  QueryBuilder sameShape( "table", QueryBuilder::Select );
+  sameShape.addColumn( "col1" );
+  sameShape.addValueCondition( "col1", Query::Equals, 6 );
+  QCOMPARE( sameShape.shapeFingerprint(), shape );
+
+  QueryBuilder isNull( "table", QueryBuilder::Select );
+  isNull.addColumn( "col1" );
+  isNull.addValueCondition( "col1", Query::Equals, QVariant() );
+  QVERIFY( isNull.shapeFingerprint() != shape );
+
+  QueryBuilder otherOperator( "table", QueryBuilder::Select );
+  otherOperator.addColumn( "col1" );
+  otherOperator.addValueCondition( "col1", Query::Less, 5 );
+  QVERIFY( otherOperator.shapeFingerprint() != shape );
+
+  QueryBuilder otherDb( "table", QueryBuilder::Select );
+  otherDb.setDatabaseType( DbType::PostgreSQL );
+  otherDb.addColumn( "col1" );
+  otherDb.addValueCondition( "col1", Query::Equals, 5 );
+  QVERIFY( otherDb.shapeFingerprint() != shape );
+
+  QueryBuilder limited( "table", QueryBuilder::Select );
+  limited.addColumn( "col1" );
+  limited.addValueCondition( "col1", Query::Equals, 5 );
+  limited.setLimit( 1 );
+  QVERIFY( limited.shapeFingerprint() != shape );
+
+  QueryBuilder twoValues( "table", QueryBuilder::Select );
+  twoValues.addColumn( "col1" );
+  twoValues.addValueCondition( "col1", Query::In, QVariantList() << 1 << 2 );
+  QueryBuilder threeValues( "table", QueryBuilder::Select );
+  threeValues.addColumn( "col1" );
+  threeValues.addValueCondition( "col1", Query::In, QVariantList() << 1 << 2 << 3 );
+  QVERIFY( twoValues.shapeFingerprint() != threeValues.shapeFingerprint() );
+
+  QueryBuilder update( "table1", QueryBuilder::Update );
+  update.setDatabaseType( DbType::Sqlite );
+  update.setColumnValue( "col", 1 );
+  update.addJoin( QueryBuilder::InnerJoin, "table2", "table1.id", "table2.id" );
+  QCOMPARE( update.shapeFingerprint(), Q_UINT64_C( 0 ) );
+}
+
 void QueryBuilderTest::benchQueryBuilder()
 {
   const QString table1 = QLatin1String("Table1");
@@ -347,3 +443,46 @@ void QueryBuilderTest::benchQueryBuilder()
 
   QVERIFY(executed);
 }
+
+void QueryBuilderTest::benchShapeFingerprint_data()
+{
+  QTest::addColumn<bool>( "fingerprint" );
+
+  QTest::newRow( "statement" ) << false;
+  QTest::newRow( "fingerprint" ) << true;
+}
+
+void QueryBuilderTest::benchShapeFingerprint()
+{
+  QFETCH( bool, fingerprint );
+
+  // a typical FetchHelper part query
+  QueryBuilder builder( "PartTable", QueryBuilder::Select );
+  builder.setDatabaseType( DbType::MySQL );
+  builder.addJoin( QueryBuilder::InnerJoin, "PimItemTable", "PartTable.pimItemId", "PimItemTable.id" );
+  builder.addJoin( QueryBuilder::InnerJoin, "PartTypeTable", "PartTable.partTypeId", "PartTypeTable.id" );
+  builder.addColumns( QStringList() << "PartTable.pimItemId" << "PartTypeTable.ns" << "PartTypeTable.name"
+                                    << "PartTable.data" << "PartTable.datasize" << "PartTable.version"
+                                    << "PartTable.external" );
+  builder.addValueCondition( "PimItemTable.collectionId", Query::Equals, 4 );
+  builder.addValueCondition( "PartTypeTable.ns", Query::Equals, QString( "PLD" ) );
+  builder.addValueCondition( "PartTable.pimItemId", Query::In, QVariantList() << 1 << 2 << 3 << 4 );
+  builder.addSortColumn( "PartTable.pimItemId", Query::Descending );
+
+  quint64 shape = 0;
+  QString statement;
+  QBENCHMARK {
+    builder.mBindValues.clear();
+    if ( fingerprint ) {
+      shape = builder.shapeFingerprint();
+      builder.collectBindValues();
+    } else {
+      statement.clear();
+      statement.reserve( 1024 );
+      builder.buildQuery( &statement );
+    }
+  }
+
+  QCOMPARE( builder.mBindValues.count(), 6 );
+  QVERIFY( fingerprint ? shape != 0 : !statement.isEmpty() );
+}
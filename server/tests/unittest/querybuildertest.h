@@ -37,7 +37,11 @@ class QueryBuilderTest : public QObject
     void testQueryBuilder_data();
     void testQueryBuilder();
 
+    void testShapeFingerprint();
+
     void benchQueryBuilder();
+    void benchShapeFingerprint_data();
+    void benchShapeFingerprint();
 
   private:
     QList< Akonadi::Server::QueryBuilder > mBuilders;
@@ -0,0 +1,173 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+
+#include <storage/datastore.h>
+#include <storage/querybuilder.h>
+#include <storage/querycache.h>
+
+#include "fakeakonadiserver.h"
+#include "aktest.h"
+#include "akdebug.h"
+#include "entities.h"
+
+#include <QtCore/QThread>
+#include <QtTest/QTest>
+
+using namespace Akonadi;
+using namespace Akonadi::Server;
+
+class QueryCacheTest : public QObject
+{
+    Q_OBJECT
+
+public:
+    QueryCacheTest()
+        : QObject()
+    {
+        try {
+            FakeAkonadiServer::instance()->setPopulateDb(false);
+            FakeAkonadiServer::instance()->init();
+        } catch (const FakeAkonadiServerException &e) {
+            akError() << "Server exception: " << e.what();
+            akFatal() << "Fake Akonadi Server failed to start up, aborting test";
+        }
+    }
+
+    ~QueryCacheTest()
+    {
+        FakeAkonadiServer::instance()->quit();
+    }
+
+    bool insertResource(const QString &name)
+    {
+        QueryBuilder qb(Resource::tableName(), QueryBuilder::Insert);
+        qb.setColumnValue(Resource::nameColumn(), name);
+        return qb.exec();
+    }
+
+    int countResources(const QString &name, QString *statement = 0)
+    {
+        QueryBuilder qb(Resource::tableName(), QueryBuilder::Select);
+        qb.addAggregation(Resource::idColumn(), QLatin1String("count"));
+        qb.addValueCondition(Resource::nameColumn(), Query::Equals, name);
+        if (!qb.exec() || !qb.query().next()) {
+            return -1;
+        }
+        if (statement) {
+            *statement = qb.query().lastQuery();
+        }
+        return qb.query().value(0).toInt();
+    }
+
+    QVariantMap statistics()
+    {
+        QString name;
+        name.sprintf("(%p)", static_cast<void *>(QThread::currentThread()));
+        const QVariantMap stats = QueryCache::statistics();
+        for (QVariantMap::ConstIterator it = stats.constBegin(); it != stats.constEnd(); ++it) {
+            if (it.key().endsWith(name)) {
+                return it.value().toMap();
+            }
+        }
+        return QVariantMap();
+    }
+
+private Q_SLOTS:
+    void testReuse()
+    {
+        QueryBuilder qb1(Resource::tableName(), QueryBuilder::Select);
+        qb1.addColumn(Resource::idColumn());
+        QVERIFY(qb1.exec());
+        const QString statement = qb1.query().lastQuery();
+        QVERIFY(QueryCache::contains(statement));
+
+        QueryBuilder qb2(Resource::tableName(), QueryBuilder::Select);
+        qb2.addColumn(Resource::idColumn());
+        QVERIFY(qb2.exec());
+        QCOMPARE(qb2.query().result(), qb1.query().result());
+    }
+
+    void testTransactions()
+    {
+        DataStore *store = DataStore::self();
+
+        QVERIFY(store->beginTransaction());
+        QVERIFY(insertResource(QLatin1String("rolledBack")));
+        QCOMPARE(countResources(QLatin1String("rolledBack")), 1);
+        QVERIFY(store->rollbackTransaction());
+        QCOMPARE(countResources(QLatin1String("rolledBack")), 0);
+
+        QVERIFY(store->beginTransaction());
+        QVERIFY(insertResource(QLatin1String("committed")));
+        QVERIFY(store->commitTransaction());
+        QCOMPARE(countResources(QLatin1String("committed")), 1);
+    }
+
+    void testReuseAfterError()
+    {
+        QVERIFY(insertResource(QLatin1String("unique")));
+        // violates the unique constraint on the name
+        QVERIFY(!insertResource(QLatin1String("unique")));
+        // the cached statement must still be usable
+        QVERIFY(insertResource(QLatin1String("unique2")));
+        QCOMPARE(countResources(QLatin1String("unique2")), 1);
+    }
+
+    void testFinishQueries()
+    {
+        QString statement;
+        QCOMPARE(countResources(QLatin1String("unique"), &statement), 1);
+        QVERIFY(QueryCache::contains(statement));
+        QVERIFY(QueryCache::query(statement).isActive());
+
+        QueryCache::finishQueries();
+        QVERIFY(!QueryCache::query(statement).isActive());
+        QCOMPARE(countResources(QLatin1String("unique")), 1);
+    }
+
+    void testStatistics()
+    {
+        const QVariantMap before = statistics();
+        QVERIFY(!before.isEmpty());
+        QVERIFY(before.value(QLatin1String("capacity")).toInt() > 0);
+
+        // the statement has been cached by the previous tests already
+        QCOMPARE(countResources(QLatin1String("statistics")), 0);
+        QCOMPARE(countResources(QLatin1String("statistics")), 0);
+        QueryBuilder qb(Resource::tableName(), QueryBuilder::Select);
+        qb.addColumn(Resource::nameColumn());
+        qb.addValueCondition(Resource::idColumn(), Query::Equals, 1);
+        // new statement
+        QVERIFY(qb.exec());
+
+        const QVariantMap after = statistics();
+        QCOMPARE(after.value(QLatin1String("hits")).toInt(), before.value(QLatin1String("hits")).toInt() + 2);
+        QCOMPARE(after.value(QLatin1String("misses")).toInt(), before.value(QLatin1String("misses")).toInt() + 1);
+        QCOMPARE(after.value(QLatin1String("size")).toInt(), before.value(QLatin1String("size")).toInt() + 1);
+
+        QueryCache::clear();
+        QCOMPARE(statistics().value(QLatin1String("size")).toInt(), 0);
+    }
+};
+
+AKTEST_FAKESERVER_MAIN(QueryCacheTest)
+
+#include "querycachetest.moc"
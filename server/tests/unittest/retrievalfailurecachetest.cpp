@@ -0,0 +1,110 @@
+/*
+    Copyright (c) 2014 Akonadi developers
+
+    This library is free software; you can redistribute it and/or modify it
+    under the terms of the GNU Library General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or (at your
+    option) any later version.
+
+    This library is distributed in the hope that it will be useful, but WITHOUT
+    ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+    FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+    License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <QObject>
+#include <QtTest/QTest>
+
+#include "storage/retrievalfailurecache.h"
+
+using namespace Akonadi::Server;
+
+class RetrievalFailureCacheTest : public QObject
+{
+  Q_OBJECT
+  private Q_SLOTS:
+    void testLookup()
+    {
+      RetrievalFailureCache cache( 60 * 1000, 100 );
+      QVERIFY( cache.isEnabled() );
+
+      const QStringList parts = QStringList() << QLatin1String( "RFC822" ) << QLatin1String( "HEAD" );
+      QString errorMsg;
+      QVERIFY( !cache.lookup( 1, 0, parts, errorMsg ) );
+
+      cache.insert( 1, 0, parts, QLatin1String( "Item not found" ) );
+      QVERIFY( cache.lookup( 1, 0, parts, errorMsg ) );
+      QCOMPARE( errorMsg, QString::fromLatin1( "Item not found" ) );
+
+      // part order does not matter
+      QVERIFY( cache.lookup( 1, 0, QStringList() << QLatin1String( "HEAD" ) << QLatin1String( "RFC822" ), errorMsg ) );
+      // different part set, different item
+      QVERIFY( !cache.lookup( 1, 0, QStringList() << QLatin1String( "HEAD" ), errorMsg ) );
+      QVERIFY( !cache.lookup( 2, 0, parts, errorMsg ) );
+
+      QCOMPARE( cache.hits(), 2LL );
+      QCOMPARE( cache.misses(), 3LL );
+    }
+
+    void testInvalidation()
+    {
+      RetrievalFailureCache cache( 60 * 1000, 100 );
+      const QStringList parts = QStringList() << QLatin1String( "RFC822" );
+      QString errorMsg;
+
+      // a new revision of the item invalidates the failure
+      cache.insert( 1, 0, parts, QLatin1String( "Item not found" ) );
+      QVERIFY( !cache.lookup( 1, 1, parts, errorMsg ) );
+      QCOMPARE( cache.size(), 0 );
+
+      cache.insert( 1, 1, parts, QLatin1String( "Item not found" ) );
+      cache.insert( 2, 1, parts, QLatin1String( "Item not found" ) );
+      cache.invalidate( 1 );
+      QVERIFY( !cache.lookup( 1, 1, parts, errorMsg ) );
+      QVERIFY( cache.lookup( 2, 1, parts, errorMsg ) );
+    }
+
+    void testExpiry()
+    {
+      RetrievalFailureCache cache( 50, 100 );
+      const QStringList parts = QStringList() << QLatin1String( "RFC822" );
+      QString errorMsg;
+
+      cache.insert( 1, 0, parts, QLatin1String( "Item not found" ) );
+      QVERIFY( cache.lookup( 1, 0, parts, errorMsg ) );
+      QTest::qWait( 100 );
+      QVERIFY( !cache.lookup( 1, 0, parts, errorMsg ) );
+    }
+
+    void testSizeLimit()
+    {
+      RetrievalFailureCache cache( 60 * 1000, 10 );
+      const QStringList parts = QStringList() << QLatin1String( "RFC822" );
+      for ( int i = 0; i < 25; ++i ) {
+        cache.insert( i, 0, parts, QLatin1String( "Item not found" ) );
+        QVERIFY( cache.size() <= 10 );
+      }
+      QString errorMsg;
+      QVERIFY( cache.lookup( 24, 0, parts, errorMsg ) );
+    }
+
+    void testDisabled()
+    {
+      RetrievalFailureCache cache( 0, 100 );
+      QVERIFY( !cache.isEnabled() );
+      const QStringList parts = QStringList() << QLatin1String( "RFC822" );
+      cache.insert( 1, 0, parts, QLatin1String( "Item not found" ) );
+      QString errorMsg;
+      QVERIFY( !cache.lookup( 1, 0, parts, errorMsg ) );
+      QCOMPARE( cache.size(), 0 );
+    }
+};
+
+QTEST_MAIN( RetrievalFailureCacheTest )
+
+#include "retrievalfailurecachetest.moc"